@@ -0,0 +1,105 @@
+/*
+
+Copyright (c) 2005-2016, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Aboria.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+#ifndef ALIGNED_ALLOCATOR_H_ 
+#define ALIGNED_ALLOCATOR_H_ 
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <new>
+
+namespace lattice {
+
+/// a standard allocator that aligns every allocation to Alignment bytes 
+/// (a power of two, by default a cache line), so that the start of the 
+/// storage can be used with aligned SIMD loads
+template <typename T, std::size_t Alignment=64>
+class aligned_allocator {
+    static_assert(Alignment >= sizeof(void*) && 
+                  (Alignment & (Alignment-1)) == 0,
+                  "Alignment must be a power of two of at least a pointer");
+public:
+    typedef T value_type;
+    typedef T* pointer;
+    typedef const T* const_pointer;
+    typedef T& reference;
+    typedef const T& const_reference;
+    typedef std::size_t size_type;
+    typedef std::ptrdiff_t difference_type;
+
+    template <typename U>
+    struct rebind {
+        typedef aligned_allocator<U,Alignment> other;
+    };
+
+    aligned_allocator() {}
+
+    template <typename U>
+    aligned_allocator(const aligned_allocator<U,Alignment>&) {}
+
+    // over-allocates by Alignment bytes and stores the pointer returned by 
+    // operator new just before the aligned block
+    T* allocate(const std::size_t n) {
+        if (n > (std::numeric_limits<std::size_t>::max() - Alignment)/sizeof(T)) {
+            throw std::bad_alloc();
+        }
+        void* const raw = ::operator new(n*sizeof(T) + Alignment);
+        const std::uintptr_t aligned = 
+            (reinterpret_cast<std::uintptr_t>(raw) + Alignment) 
+            & ~std::uintptr_t(Alignment-1);
+        reinterpret_cast<void**>(aligned)[-1] = raw;
+        return reinterpret_cast<T*>(aligned);
+    }
+
+    void deallocate(T* const p, const std::size_t) {
+        ::operator delete(reinterpret_cast<void**>(p)[-1]);
+    }
+};
+
+template <typename T, typename U, std::size_t Alignment>
+bool operator==(const aligned_allocator<T,Alignment>&, 
+                const aligned_allocator<U,Alignment>&) {
+    return true;
+}
+
+template <typename T, typename U, std::size_t Alignment>
+bool operator!=(const aligned_allocator<T,Alignment>&, 
+                const aligned_allocator<U,Alignment>&) {
+    return false;
+}
+
+}
+
+#endif
@@ -0,0 +1,546 @@
+/*
+
+Copyright (c) 2005-2016, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Aboria.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+#ifndef COLOURED_LATTICE_ITERATOR_H_ 
+#define COLOURED_LATTICE_ITERATOR_H_ 
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include "lattice_iterator.h"
+#include "lattice_range.h"
+#include "for_each.h"
+#include "parallel_for.h"
+
+namespace lattice {
+
+/// iterates over one colour class of the box [min,max), the points whose 
+/// coordinates sum to colour modulo colours, in row-major order. Face 
+/// neighbours always have different colours, so with two colours (red-black) 
+/// or more the points of one colour can be updated in place, e.g. by a 
+/// Gauss-Seidel or SOR smoother. The innermost dimension steps by colours, 
+/// so no points of the other colours are visited. There can be at most 
+/// max_colours colours
+template <unsigned int D, typename Coord=int, typename Index=std::ptrdiff_t>
+class coloured_lattice_iterator {
+    typedef coloured_lattice_iterator<D,Coord,Index> iterator;
+    typedef std::array<Coord,D> int_d;
+
+public:
+    typedef typename lattice_iterator<D,Coord,Index>::stride_type stride_type;
+    static const Coord max_colours = 8;
+
+private:
+    // suffix counts for each dimension and residue, see suffix_counts()
+    typedef std::array<Index,(D+1)*max_colours> counts_type;
+
+    int_d m_min;
+    int_d m_max;
+    int_d m_index;
+    stride_type m_stride;
+    Coord m_colour;
+    Coord m_colours;
+    // sum of the coordinates before the innermost one
+    Coord m_outer_sum;
+    Index m_offset;
+    bool m_valid;
+
+public:
+    typedef const int_d* pointer;
+	typedef std::random_access_iterator_tag iterator_category;
+	typedef std::random_access_iterator_tag iterator_concept;
+    typedef const int_d reference;
+    typedef int_d value_type;
+	typedef Index difference_type;
+
+    coloured_lattice_iterator():
+        m_min(),
+        m_max(),
+        m_index(),
+        m_stride(),
+        m_colour(0),
+        m_colours(1),
+        m_outer_sum(0),
+        m_offset(0),
+        m_valid(false)
+    {}
+
+    coloured_lattice_iterator(const int_d &min, 
+                              const int_d &max,
+                              const Coord colour,
+                              const Coord colours=2):
+        m_min(min),
+        m_max(max),
+        m_stride(lattice_iterator<D,Coord,Index>(min,max).get_stride()),
+        m_colour(colour),
+        m_colours(colours)
+    {
+        init();
+    }
+
+    coloured_lattice_iterator(const int_d &min, 
+                              const int_d &max,
+                              const stride_type &stride,
+                              const Coord colour,
+                              const Coord colours=2):
+        m_min(min),
+        m_max(max),
+        m_stride(stride),
+        m_colour(colour),
+        m_colours(colours)
+    {
+        init();
+    }
+
+    const int_d& get_min() const { return m_min; }
+    const int_d& get_max() const { return m_max; }
+    const stride_type& get_stride() const { return m_stride; }
+    Coord get_colour() const { return m_colour; }
+    Coord get_colours() const { return m_colours; }
+
+    explicit operator size_t() const {
+        return m_offset;
+    }
+
+    reference operator *() const {
+        return m_index;
+    }
+
+    pointer operator ->() const {
+        return &m_index;
+    }
+
+    reference operator [](const difference_type n) const {
+        return *(*this + n);
+    }
+
+    iterator& operator++() {
+        increment();
+        return *this;
+    }
+
+    iterator operator++(int) {
+        iterator tmp(*this);
+        operator++();
+        return tmp;
+    }
+
+    iterator& operator--() {
+        decrement();
+        return *this;
+    }
+
+    iterator operator--(int) {
+        iterator tmp(*this);
+        operator--();
+        return tmp;
+    }
+
+    iterator operator+(const difference_type n) const {
+        iterator tmp(*this);
+        tmp.increment(n);
+        return tmp;
+    }
+
+    iterator& operator+=(const difference_type n) {
+        increment(n);
+        return *this;
+    }
+
+    iterator& operator-=(const difference_type n) {
+        increment(-n);
+        return *this;
+    }
+
+    iterator operator-(const difference_type n) const {
+        iterator tmp(*this);
+        tmp.increment(-n);
+        return tmp;
+    }
+
+    difference_type operator-(const iterator& start) const {
+        if (!m_valid) {
+            if (!start.m_valid) return 0;
+            return start.colour_size() - start.linear_position();
+        } else if (!start.m_valid) {
+            return linear_position() - colour_size();
+        } else {
+            return linear_position() - start.linear_position();
+        }
+    }
+
+    inline bool operator<(const iterator& rhs) const {
+        return *this - rhs < 0;
+    }
+
+    inline bool operator>(const iterator& rhs) const {
+        return rhs < *this;
+    }
+
+    inline bool operator<=(const iterator& rhs) const {
+        return !(rhs < *this);
+    }
+
+    inline bool operator>=(const iterator& rhs) const {
+        return !(*this < rhs);
+    }
+
+    inline bool operator==(const iterator& rhs) const {
+        if (!rhs.m_valid) return !m_valid;
+        if (!m_valid) return !rhs.m_valid;
+        return m_index == rhs.m_index;
+    }
+
+    inline bool operator==(const bool rhs) const {
+        return m_valid==rhs;
+    }
+
+    inline bool operator!=(const iterator& rhs) const {
+        return !operator==(rhs);
+    }
+
+    inline bool operator!=(const bool rhs) const {
+        return !operator==(rhs);
+    }
+
+private:
+    // a modulo m_colours in [0,m_colours), also for negative a
+    Coord residue(const Index a) const {
+        const Coord r = static_cast<Coord>(a % m_colours);
+        return r < 0 ? r + m_colours : r;
+    }
+
+    // the number of x in [a,b) with x = r modulo m_colours
+    Index count_residue(const Coord a, const Coord b, const Coord r) const {
+        if (b <= a) return 0;
+        const Coord first = a + residue(Index(r) - a);
+        return first < b ? (b - first - 1)/m_colours + 1 : 0;
+    }
+
+    // counts[d*m_colours + r] is the number of points in the box with the 
+    // coordinates from d onwards summing to r modulo m_colours
+    counts_type suffix_counts() const {
+        counts_type counts;
+        std::fill(counts.begin(),counts.begin() + (D+1)*m_colours,0);
+        counts[D*m_colours] = 1;
+        for (int d = D-1; d >= 0; --d) {
+            for (Coord r = 0; r < m_colours; ++r) {
+                const Index n = count_residue(m_min[d],m_max[d],r);
+                for (Coord s = 0; s < m_colours; ++s) {
+                    counts[d*m_colours + residue(r+s)] += 
+                        n*counts[(d+1)*m_colours + s];
+                }
+            }
+        }
+        return counts;
+    }
+
+    Index colour_size() const {
+        return suffix_counts()[m_colour];
+    }
+
+    void init() {
+        assert(m_colours > 0 && m_colour >= 0 && m_colour < m_colours);
+        assert(m_colours <= max_colours);
+        m_valid = true;
+        for (size_t i = 0; i < D; ++i) {
+            if (m_max[i] <= m_min[i]) m_valid = false;
+        }
+        m_index = m_min;
+        m_outer_sum = 0;
+        for (size_t i = 0; i+1 < D; ++i) {
+            m_outer_sum += m_min[i];
+        }
+        if (!m_valid) return;
+        m_index[D-1] = first_in_row();
+        update_offset();
+        if (m_index[D-1] >= m_max[D-1]) next_row();
+    }
+
+    void update_offset() {
+        m_offset = 0;
+        for (size_t i = 0; i < D; ++i) {
+            m_offset += m_stride[i]*m_index[i];
+        }
+    }
+
+    Coord first_in_row() const {
+        return m_min[D-1] + residue(Index(m_colour) - m_outer_sum - m_min[D-1]);
+    }
+
+    // moves to the first point of the colour in the next row that has one
+    void next_row() {
+        do {
+            m_offset -= m_stride[D-1]*m_index[D-1];
+            int i = D-2;
+            for (; i >= 0; --i) {
+                ++m_index[i];
+                ++m_outer_sum;
+                m_offset += m_stride[i];
+                if (m_index[i] < m_max[i]) break;
+                m_outer_sum -= m_index[i]-m_min[i];
+                m_offset -= m_stride[i]*(m_index[i]-m_min[i]);
+                m_index[i] = m_min[i];
+            }
+            if (i < 0) {
+                m_valid = false;
+                return;
+            }
+            m_index[D-1] = first_in_row();
+            m_offset += m_stride[D-1]*m_index[D-1];
+        } while (m_index[D-1] >= m_max[D-1]);
+    }
+
+    void increment() {
+        m_index[D-1] += m_colours;
+        m_offset += m_stride[D-1]*m_colours;
+        if (m_index[D-1] >= m_max[D-1]) next_row();
+    }
+
+    // the number of points of the colour before m_index in row-major order
+    Index linear_position() const {
+        const counts_type counts = suffix_counts();
+        Index position = 0;
+        Index prefix = 0;
+        for (size_t d = 0; d < D; ++d) {
+            for (Coord r = 0; r < m_colours; ++r) {
+                position += count_residue(m_min[d],m_index[d],r)
+                    * counts[(d+1)*m_colours + residue(m_colour - prefix - r)];
+            }
+            prefix += m_index[d];
+        }
+        return position;
+    }
+
+    void set_linear_position(Index position) {
+        assert(position >= 0);
+        const counts_type counts = suffix_counts();
+        if (position >= counts[m_colour]) {
+            m_valid = false;
+            return;
+        }
+        Index prefix = 0;
+        for (size_t d = 0; d < D; ++d) {
+            const Index* count = &counts[(d+1)*m_colours];
+            // every m_colours consecutive slabs have all the residues once 
+            Index volume = 0;
+            for (Coord r = 0; r < m_colours; ++r) {
+                volume += count[r];
+            }
+            Index periods = position/volume;
+            if (periods > (m_max[d]-m_min[d])/m_colours) {
+                periods = (m_max[d]-m_min[d])/m_colours;
+            }
+            Coord x = m_min[d] + static_cast<Coord>(periods*m_colours);
+            position -= periods*volume;
+            for (;; ++x) {
+                assert(x < m_max[d]);
+                const Index n = count[residue(m_colour - prefix - x)];
+                if (position < n) break;
+                position -= n;
+            }
+            m_index[d] = x;
+            prefix += x;
+        }
+        m_outer_sum = static_cast<Coord>(prefix - m_index[D-1]);
+        update_offset();
+        m_valid = true;
+    }
+
+    void decrement() {
+        // a default constructed end iterator has an empty box
+        assert(m_valid || colour_size() > 0);
+        if (!m_valid && colour_size() == 0) return;
+        increment(-1);
+    }
+
+    void increment(const Index n) {
+        set_linear_position((m_valid ? linear_position() : colour_size()) + n);
+    }
+};
+
+template <unsigned int D, typename Coord, typename Index>
+coloured_lattice_iterator<D,Coord,Index> operator+(
+        const typename coloured_lattice_iterator<D,Coord,Index>::difference_type n, 
+        const coloured_lattice_iterator<D,Coord,Index>& it) {
+    return it + n;
+}
+
+/// calls f for every point of the colour in [begin,end). If this is the 
+/// whole colour class (begin is its first point and end is the end iterator 
+/// or false) it is lowered to nested for loops over the outer dimensions, 
+/// with an inner loop that steps by the number of colours. As for for_each 
+/// over a lattice_iterator, f is called as f(index,offset) if it takes two 
+/// arguments
+template <unsigned int D, typename Coord, typename Index, typename End, 
+          typename F>
+void for_each(coloured_lattice_iterator<D,Coord,Index> begin, const End& end, 
+              F f) {
+    typedef std::array<Coord,D> int_d;
+    if (begin == false) return;
+    const int_d min = begin.get_min();
+    if (begin != coloured_lattice_iterator<D,Coord,Index>(min,begin.get_max(),
+                        begin.get_stride(),begin.get_colour(),
+                        begin.get_colours()) || !(end == false)) {
+        for (; begin != end; ++begin) {
+            detail::call_with_offset(f,*begin,
+                                     static_cast<Index>(size_t(begin)),0);
+        }
+        return;
+    }
+    int_d max = begin.get_max();
+    const Coord inner_max = max[D-1];
+    max[D-1] = min[D-1]+1;
+    const auto& stride = begin.get_stride();
+    const Coord colour = begin.get_colour();
+    const Coord colours = begin.get_colours();
+    lattice::for_each(min,max,stride,
+        [&](const int_d& row, const Index row_offset) {
+            int_d index = row;
+            Index sum = 0;
+            for (size_t i = 0; i+1 < D; ++i) {
+                sum += row[i];
+            }
+            Coord first = static_cast<Coord>((colour - sum - min[D-1]) % colours);
+            if (first < 0) first += colours;
+            const Index inner_stride = stride[D-1];
+            for (Coord i = min[D-1] + first; i < inner_max; i += colours) {
+                index[D-1] = i;
+                detail::call_with_offset(f,index,
+                        row_offset + (i-min[D-1])*inner_stride,0);
+            }
+        });
+}
+
+/// a splittable range over one colour class of the box [min,max), for 
+/// parallel_for or tbb::parallel_for. Splitting cuts the box as for 
+/// lattice_range, and each piece visits its points of the colour
+template <unsigned int D, typename Coord=int, typename Index=std::ptrdiff_t>
+class coloured_lattice_range {
+    typedef std::array<Coord,D> int_d;
+public:
+    typedef coloured_lattice_iterator<D,Coord,Index> iterator;
+    typedef iterator const_iterator;
+    typedef typename iterator::stride_type stride_type;
+
+private:
+    lattice_range<D,Coord,Index> m_box;
+    Coord m_colour;
+    Coord m_colours;
+
+public:
+    coloured_lattice_range(const int_d &min, 
+                           const int_d &max,
+                           const Coord colour,
+                           const Coord colours=2,
+                           const Index grainsize=1):
+        m_box(min,max,grainsize),
+        m_colour(colour),
+        m_colours(colours)
+    {}
+
+    coloured_lattice_range(const int_d &min, 
+                           const int_d &max,
+                           const stride_type &stride,
+                           const Coord colour,
+                           const Coord colours=2,
+                           const Index grainsize=1):
+        m_box(min,max,stride,grainsize),
+        m_colour(colour),
+        m_colours(colours)
+    {}
+
+    /// splits r in two along the longest dimension of its box
+    template <typename Split>
+    coloured_lattice_range(coloured_lattice_range &r, Split s):
+        m_box(r.m_box,s),
+        m_colour(r.m_colour),
+        m_colours(r.m_colours)
+    {}
+
+    const int_d& get_min() const { return m_box.get_min(); }
+    const int_d& get_max() const { return m_box.get_max(); }
+    const stride_type& get_stride() const { return m_box.get_stride(); }
+    Coord get_colour() const { return m_colour; }
+    Coord get_colours() const { return m_colours; }
+    Index grainsize() const { return m_box.grainsize(); }
+
+    iterator begin() const { 
+        return iterator(get_min(),get_max(),get_stride(),m_colour,m_colours);
+    }
+
+    // the end iterator keeps the box, so that it can be decremented
+    iterator end() const { 
+        return begin() + size(); 
+    }
+
+    Index size() const {
+        return iterator() - begin();
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+
+    /// divisible while the box has more than grainsize points (of any 
+    /// colour)
+    bool is_divisible() const {
+        return m_box.is_divisible();
+    }
+
+    template <typename F>
+    void for_each(F f) const { 
+        lattice::for_each(begin(),end(),f); 
+    }
+};
+
+/// parallel_for over one colour class, e.g. the red points of a red-black 
+/// Gauss-Seidel sweep, which can then be updated in place
+template <unsigned int D, typename Coord, typename Index, typename F>
+void parallel_for(const coloured_lattice_range<D,Coord,Index>& range, F f,
+                  const parallel_options<Index>& options = 
+                                            parallel_options<Index>()) {
+    typedef coloured_lattice_range<D,Coord,Index> range_type;
+    thread_pool& pool = options.pool ? *options.pool : default_thread_pool();
+    detail::parallel_for_job<range_type,F> job(pool,f,range.size());
+    job.run(range_type(range.get_min(),range.get_max(),range.get_stride(),
+                       range.get_colour(),range.get_colours(),
+                       options.grainsize));
+    pool.run_until([&job]() { return job.remaining == 0; });
+    if (job.error) std::rethrow_exception(job.error);
+}
+
+}
+
+#endif
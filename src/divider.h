@@ -0,0 +1,96 @@
+/*
+
+Copyright (c) 2005-2016, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Aboria.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+#ifndef DIVIDER_H_ 
+#define DIVIDER_H_ 
+
+#include <cstdint>
+#include <cassert>
+
+namespace lattice {
+
+/// Division by a run-time invariant unsigned integer using a precomputed
+/// magic number (Granlund & Montgomery, "Division by invariant integers using
+/// multiplication", fig 4.1), in the style of libdivide. The quotient is
+/// exact for every 64-bit numerator and for every divisor >= 1. Falls back to
+/// a hardware divide if the compiler has no 128-bit integer type.
+class divider {
+    typedef std::uint64_t uint_t;
+#ifdef __SIZEOF_INT128__
+    __extension__ typedef unsigned __int128 uint2_t;
+#endif
+
+    uint_t m_divisor;
+    uint_t m_magic;
+    unsigned int m_shift1;
+    unsigned int m_shift2;
+
+public:
+    divider():
+        m_divisor(1),m_magic(1),m_shift1(0),m_shift2(0)
+    {}
+
+    explicit divider(const uint_t d):
+        m_divisor(d)
+    {
+        assert(d > 0);
+        unsigned int l = 0;
+        while (l < 64 && (uint_t(1) << l) < d) ++l;
+#ifdef __SIZEOF_INT128__
+        m_magic = static_cast<uint_t>(
+                ((((uint2_t)1 << l) - d) << 64) / d + 1);
+#else
+        m_magic = 0;
+#endif
+        m_shift1 = l < 1 ? l : 1;
+        m_shift2 = l > 0 ? l-1 : 0;
+    }
+
+    uint_t divisor() const {
+        return m_divisor;
+    }
+
+    inline uint_t divide(const uint_t n) const {
+#ifdef __SIZEOF_INT128__
+        const uint_t t = static_cast<uint_t>(((uint2_t)m_magic * n) >> 64);
+        return (t + ((n - t) >> m_shift1)) >> m_shift2;
+#else
+        return n / m_divisor;
+#endif
+    }
+};
+
+}
+
+#endif
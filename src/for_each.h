@@ -0,0 +1,190 @@
+/*
+
+Copyright (c) 2005-2016, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Aboria.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+#ifndef FOR_EACH_H_ 
+#define FOR_EACH_H_ 
+
+#include <array>
+#include <cstddef>
+#include <iterator>
+#include <utility>
+#include "lattice_iterator.h"
+
+namespace lattice {
+
+namespace detail {
+
+// call f(index,offset) if f takes two arguments, otherwise f(index)
+template <typename F, typename Array, typename Index>
+inline auto call_with_offset(F& f, const Array& index, const Index offset, int)
+    -> decltype(f(index,offset), void()) {
+    f(index,offset);
+}
+
+template <typename F, typename Array, typename Index>
+inline void call_with_offset(F& f, const Array& index, const Index, long) {
+    f(index);
+}
+
+// call f(*it,size_t(it)) if f takes two arguments and it has a linear 
+// offset, otherwise f(*it)
+template <typename F, typename Iterator>
+inline auto call_with_iterator(F& f, const Iterator& it, int)
+    -> decltype(static_cast<std::size_t>(it), void()) {
+    typedef typename std::iterator_traits<Iterator>::difference_type Index;
+    call_with_offset(f,*it,static_cast<Index>(static_cast<std::size_t>(it)),0);
+}
+
+template <typename F, typename Iterator>
+inline void call_with_iterator(F& f, const Iterator& it, long) {
+    f(*it);
+}
+
+// the number of points from begin to end, where end is an iterator or 
+// false for the end of begin's box
+template <typename Iterator>
+typename Iterator::difference_type distance_to(const Iterator& begin, 
+                                               const Iterator& end) {
+    return end - begin;
+}
+
+template <typename Iterator>
+typename Iterator::difference_type distance_to(const Iterator& begin, 
+                                               const bool) {
+    return Iterator() - begin;
+}
+
+template <unsigned int I, unsigned int D, bool Inner = (I+1 == D)>
+struct nested_for {
+    template <typename Coord, typename Index, typename F>
+    static inline void loop(const std::array<Coord,D>& min,
+                            const std::array<Coord,D>& max,
+                            const std::array<Index,D>& stride,
+                            std::array<Coord,D>& index,
+                            Index offset,
+                            F& f) {
+        for (index[I] = min[I]; index[I] < max[I]; 
+                ++index[I], offset += stride[I]) {
+            nested_for<I+1,D>::loop(min,max,stride,index,offset,f);
+        }
+    }
+};
+
+// the innermost loop has a plain counter and a linear offset, so that the 
+// body can be auto-vectorized
+template <unsigned int I, unsigned int D>
+struct nested_for<I,D,true> {
+    template <typename Coord, typename Index, typename F>
+    static inline void loop(const std::array<Coord,D>& min,
+                            const std::array<Coord,D>& max,
+                            const std::array<Index,D>& stride,
+                            std::array<Coord,D>& index,
+                            const Index offset,
+                            F& f) {
+        const Coord n = max[I]-min[I];
+        for (Coord i = 0; i < n; ++i) {
+            index[I] = min[I] + i;
+            call_with_offset(f,index,offset + i*stride[I],0);
+        }
+    }
+};
+
+}
+
+/// calls f for every point in the box [min,max) in row-major order, using D
+/// nested for loops instead of a lattice_iterator. f is called as 
+/// f(index,offset) if it takes two arguments, where offset is the linear
+/// offset of index calculated using stride, otherwise as f(index)
+template <typename Coord, std::size_t D, typename Index, typename F>
+void for_each(const std::array<Coord,D>& min, 
+              const std::array<Coord,D>& max, 
+              const std::array<Index,D>& stride, 
+              F f) {
+    for (std::size_t i = 0; i < D; ++i) {
+        if (max[i] <= min[i]) return;
+    }
+    Index offset = 0;
+    for (std::size_t i = 0; i < D; ++i) {
+        offset += stride[i]*min[i];
+    }
+    std::array<Coord,D> index = min;
+    detail::nested_for<0,D>::loop(min,max,stride,index,offset,f);
+}
+
+/// as above, with row-major strides for the box [min,max)
+template <typename Coord, std::size_t D, typename F>
+void for_each(const std::array<Coord,D>& min, 
+              const std::array<Coord,D>& max, 
+              F f) {
+    std::array<std::ptrdiff_t,D> stride;
+    stride[D-1] = 1;
+    for (int i = D-2; i >= 0; --i) {
+        stride[i] = stride[i+1]*(max[i+1]-min[i+1]);
+    }
+    for_each(min,max,stride,f);
+}
+
+/// calls f for every it in [begin,end), as f(*it,size_t(it)) if f takes 
+/// two arguments and the iterator has a linear offset, otherwise as f(*it)
+template <typename Iterator, typename End, typename F>
+void for_each(Iterator begin, const End& end, F f) {
+    for (; begin != end; ++begin) {
+        detail::call_with_iterator(f,begin,0);
+    }
+}
+
+/// calls f for every point in [begin,end). This is lowered to nested for 
+/// loops if the range is the whole box (begin is at the start of the box, 
+/// end is the end iterator or false) and steps through every point
+template <unsigned int D, typename Coord, typename Index, typename End, 
+          typename F>
+void for_each(lattice_iterator<D,Coord,Index> begin, const End& end, F f) {
+    if (begin == false) return;
+    bool unit_steps = true;
+    for (size_t i = 0; i < D; ++i) {
+        if (begin.get_step()[i] != 1) unit_steps = false;
+    }
+    if (*begin != begin.get_min() || !(end == false) || !unit_steps) {
+        for (; begin != end; ++begin) {
+            detail::call_with_offset(f,*begin,
+                                     static_cast<Index>(size_t(begin)),0);
+        }
+        return;
+    }
+    for_each(begin.get_min(),begin.get_max(),begin.get_stride(),f);
+}
+
+}
+
+#endif
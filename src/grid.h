@@ -0,0 +1,472 @@
+/*
+
+Copyright (c) 2005-2016, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Aboria.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+#ifndef GRID_H_ 
+#define GRID_H_ 
+
+#include <algorithm>
+#include <array>
+#include <vector>
+#include <cstddef>
+#include "aligned_allocator.h"
+#include "lattice_iterator.h"
+#include "morton_lattice_iterator.h"
+#include "for_each.h"
+#include "range.h"
+
+namespace lattice {
+
+/// storage layouts for grid. Each layout has a nested mapping<D,Coord,Index> 
+/// with the number of elements needed to store the box [min,max), the 
+/// storage offset of a point, and a for_each(f) that calls f(index,offset) 
+/// for every point in the box in storage order
+
+/// the last dimension is contiguous, as for lattice_iterator
+struct row_major {
+    template <unsigned int D, typename Coord, typename Index>
+    class mapping {
+        typedef std::array<Coord,D> int_d;
+        typedef std::array<Index,D> stride_type;
+
+        int_d m_min;
+        int_d m_max;
+        stride_type m_stride;
+        Index m_origin;
+
+    public:
+        mapping(const int_d& min, const int_d& max):
+            mapping(min,max,
+                    lattice_iterator<D,Coord,Index>(min,max).get_stride())
+        {}
+
+        // row-major with the given strides, which can be larger than the 
+        // extents of the box to pad each row
+        mapping(const int_d& min, const int_d& max, const stride_type& stride):
+            m_min(min),
+            m_max(max),
+            m_stride(stride),
+            m_origin(0)
+        {
+            for (size_t i = 0; i < D; ++i) {
+                m_origin += m_stride[i]*m_min[i];
+            }
+        }
+
+        const stride_type& get_stride() const { return m_stride; }
+
+        /// the offset of the point zero, so that the storage offset of the 
+        /// point at iterator it is size_t(it) - get_origin() for any 
+        /// lattice_iterator constructed with get_stride()
+        Index get_origin() const { return m_origin; }
+
+        Index size() const {
+            return m_max[0] > m_min[0] ? m_stride[0]*(m_max[0]-m_min[0]) : 0;
+        }
+
+        Index operator()(const int_d& index) const {
+            Index offset = -m_origin;
+            for (size_t i = 0; i < D; ++i) {
+                offset += m_stride[i]*index[i];
+            }
+            return offset;
+        }
+
+        template <typename F>
+        void for_each(F f) const {
+            const Index origin = m_origin;
+            lattice::for_each(m_min,m_max,m_stride,
+                    [&](const int_d& index, const Index offset) {
+                        f(index,offset-origin);
+                    });
+        }
+    };
+};
+
+/// row-major, with the innermost dimension padded to an odd multiple of 
+/// Pitch elements. Pitch counts elements, not bytes, so it must be chosen 
+/// for the element type: the default of 8 is one cache line of doubles, use 
+/// 16 for floats. With the 64-byte aligned storage of grid and a Pitch of 
+/// one cache line every row starts on a cache line, so the inner loop can 
+/// use aligned SIMD loads. Making the pitch an odd number of cache lines 
+/// means neighbouring rows of 2^n sized grids are never a multiple of 4KB 
+/// apart, which avoids 4K aliasing between their loads and stores. Only the 
+/// rows are padded, so neighbouring planes of a 3D grid can still map to 
+/// the same cache sets
+template <std::size_t Pitch=8>
+struct padded_row_major {
+    template <unsigned int D, typename Coord, typename Index>
+    class mapping: public row_major::mapping<D,Coord,Index> {
+        typedef row_major::mapping<D,Coord,Index> base;
+        typedef std::array<Coord,D> int_d;
+        typedef std::array<Index,D> stride_type;
+
+        static stride_type padded_stride(const int_d& min, const int_d& max) {
+            stride_type stride;
+            stride[D-1] = 1;
+            if (D > 1) {
+                const Index size = max[D-1] > min[D-1] ? max[D-1]-min[D-1] : 0;
+                const Index multiple = Pitch;
+                Index pitch = (size + multiple - 1)/multiple;
+                if (pitch % 2 == 0) ++pitch;
+                stride[D > 1 ? D-2 : 0] = pitch*multiple;
+            }
+            for (int i = int(D)-3; i >= 0; --i) {
+                stride[i] = stride[i+1]*(max[i+1]-min[i+1]);
+            }
+            return stride;
+        }
+
+    public:
+        mapping(const int_d& min, const int_d& max):
+            base(min,max,padded_stride(min,max))
+        {}
+    };
+};
+
+/// the first dimension is contiguous, as for Fortran arrays
+struct column_major {
+    template <unsigned int D, typename Coord, typename Index>
+    class mapping {
+        typedef std::array<Coord,D> int_d;
+        typedef std::array<Index,D> stride_type;
+
+        int_d m_min;
+        int_d m_max;
+        stride_type m_stride;
+        Index m_origin;
+
+        static int_d reverse(const int_d& arg) {
+            int_d ret;
+            for (size_t i = 0; i < D; ++i) {
+                ret[i] = arg[D-1-i];
+            }
+            return ret;
+        }
+
+    public:
+        mapping(const int_d& min, const int_d& max):
+            m_min(min),
+            m_max(max),
+            m_origin(0)
+        {
+            m_stride[0] = 1;
+            for (size_t i = 1; i < D; ++i) {
+                m_stride[i] = m_stride[i-1]*(m_max[i-1]-m_min[i-1]);
+            }
+            for (size_t i = 0; i < D; ++i) {
+                m_origin += m_stride[i]*m_min[i];
+            }
+        }
+
+        const stride_type& get_stride() const { return m_stride; }
+        Index get_origin() const { return m_origin; }
+
+        Index size() const {
+            return m_max[D-1] > m_min[D-1] ? 
+                        m_stride[D-1]*(m_max[D-1]-m_min[D-1]) : 0;
+        }
+
+        Index operator()(const int_d& index) const {
+            Index offset = -m_origin;
+            for (size_t i = 0; i < D; ++i) {
+                offset += m_stride[i]*index[i];
+            }
+            return offset;
+        }
+
+        // row-major loops over the reversed box
+        template <typename F>
+        void for_each(F f) const {
+            stride_type stride;
+            for (size_t i = 0; i < D; ++i) {
+                stride[i] = m_stride[D-1-i];
+            }
+            const Index origin = m_origin;
+            lattice::for_each(reverse(m_min),reverse(m_max),stride,
+                    [&](const int_d& reversed, const Index offset) {
+                        f(reverse(reversed),offset-origin);
+                    });
+        }
+    };
+};
+
+/// the box is stored as consecutive tiles of size Tile..., each in 
+/// row-major order, matching the order of tiled_lattice_iterator. Storage 
+/// is padded to a whole number of tiles in each dimension
+template <int... Tile>
+struct tiled {
+    template <unsigned int D, typename Coord, typename Index>
+    class mapping {
+        static_assert(sizeof...(Tile) == D, 
+                      "tiled layout needs one tile size per dimension");
+        typedef std::array<Coord,D> int_d;
+        typedef std::array<Index,D> stride_type;
+
+        int_d m_min;
+        int_d m_max;
+        int_d m_tiles;
+        stride_type m_tile_stride;
+        stride_type m_stride;
+        Index m_tile_size;
+
+        static Coord tile(const size_t i) {
+            static const Coord sizes[D] = {static_cast<Coord>(Tile)...};
+            return sizes[i];
+        }
+
+    public:
+        mapping(const int_d& min, const int_d& max):
+            m_min(min),
+            m_max(max),
+            m_tile_size(1)
+        {
+            for (size_t i = 0; i < D; ++i) {
+                const Coord size = m_max[i] > m_min[i] ? m_max[i]-m_min[i] : 0;
+                m_tiles[i] = (size + tile(i) - 1)/tile(i);
+                m_tile_size *= tile(i);
+            }
+            m_stride[D-1] = 1;
+            m_tile_stride[D-1] = m_tile_size;
+            for (int i = D-2; i >= 0; --i) {
+                m_stride[i] = m_stride[i+1]*tile(i+1);
+                m_tile_stride[i] = m_tile_stride[i+1]*m_tiles[i+1];
+            }
+        }
+
+        Index size() const {
+            return m_tile_stride[0]*m_tiles[0];
+        }
+
+        Index operator()(const int_d& index) const {
+            Index offset = 0;
+            for (size_t i = 0; i < D; ++i) {
+                const Coord relative = index[i]-m_min[i];
+                offset += m_tile_stride[i]*(relative/tile(i)) 
+                            + m_stride[i]*(relative%tile(i));
+            }
+            return offset;
+        }
+
+        template <typename F>
+        void for_each(F f) const {
+            const int_d zero = int_d();
+            const stride_type& stride = m_stride;
+            lattice::for_each(zero,m_tiles,m_tile_stride,
+                    [&](const int_d& tile_index, const Index tile_offset) {
+                int_d tile_min, tile_max;
+                Index origin = 0;
+                for (size_t i = 0; i < D; ++i) {
+                    tile_min[i] = m_min[i] + tile_index[i]*tile(i);
+                    tile_max[i] = std::min(tile_min[i] + tile(i),m_max[i]);
+                    origin += stride[i]*tile_min[i];
+                }
+                lattice::for_each(tile_min,tile_max,stride,
+                        [&](const int_d& index, const Index offset) {
+                            f(index,tile_offset + offset - origin);
+                        });
+            });
+        }
+    };
+};
+
+/// the box is stored in Morton order, using the Morton code of index-min as 
+/// the offset. Storage is dense for power-of-two cubes, other boxes are 
+/// padded up to the largest code in the box
+struct morton {
+    template <unsigned int D, typename Coord, typename Index>
+    class mapping {
+        typedef std::array<Coord,D> int_d;
+
+        int_d m_min;
+        int_d m_max;
+        Index m_size;
+
+    public:
+        mapping(const int_d& min, const int_d& max):
+            m_min(min),
+            m_max(max),
+            m_size(0)
+        {
+            int_d last;
+            for (size_t i = 0; i < D; ++i) {
+                if (m_max[i] <= m_min[i]) return;
+                last[i] = m_max[i]-m_min[i]-1;
+            }
+            m_size = static_cast<Index>(morton_encode<D>(last)) + 1;
+        }
+
+        Index size() const {
+            return m_size;
+        }
+
+        Index operator()(const int_d& index) const {
+            int_d relative;
+            for (size_t i = 0; i < D; ++i) {
+                relative[i] = index[i]-m_min[i];
+            }
+            return static_cast<Index>(morton_encode<D>(relative));
+        }
+
+        template <typename F>
+        void for_each(F f) const {
+            for (morton_lattice_iterator<D,Coord,Index> it(m_min,m_max); 
+                    it != false; ++it) {
+                f(*it,static_cast<Index>(it.get_code()));
+            }
+        }
+    };
+};
+
+namespace detail {
+
+// the storage offset of the point at iterator it. An iterator built with 
+// the strides of the mapping already holds the offset plus the origin, so 
+// the coordinates only need collapsing for other iterators and layouts
+template <typename Index, typename Mapping, typename Iterator>
+auto storage_offset(const Mapping& m, const Iterator& it, int) 
+    -> decltype(m.get_stride() == it.get_stride(), size_t(it), 
+                m.get_origin(), Index()) {
+    if (m.get_stride() == it.get_stride()) {
+        return static_cast<Index>(size_t(it)) - m.get_origin();
+    }
+    return m(*it);
+}
+
+template <typename Index, typename Mapping, typename Iterator>
+Index storage_offset(const Mapping& m, const Iterator& it, long) {
+    return m(*it);
+}
+
+}
+
+/// a D-dimensional array of T over the box [min,max), indexed directly by 
+/// point (or by any lattice iterator), and stored in the order given by 
+/// Layout. for_each() visits the points in storage order, so that loops 
+/// over the whole grid are contiguous in memory whatever the layout. The 
+/// storage is aligned to a cache line
+template <typename T, unsigned int D, typename Layout=row_major, 
+          typename Coord=int, typename Index=std::ptrdiff_t>
+class grid {
+public:
+    typedef std::array<Coord,D> int_d;
+    typedef typename Layout::template mapping<D,Coord,Index> mapping_type;
+    typedef T value_type;
+    typedef T& reference;
+    typedef const T& const_reference;
+    typedef lattice_iterator<D,Coord,Index> iterator;
+
+private:
+    int_d m_min;
+    int_d m_max;
+    mapping_type m_mapping;
+    std::vector<T,aligned_allocator<T>> m_data;
+
+public:
+    grid(const int_d& min, const int_d& max, const T& value=T()):
+        m_min(min),
+        m_max(max),
+        m_mapping(min,max),
+        m_data(m_mapping.size(),value)
+    {}
+
+    /// a grid with the same box as range, e.g. 
+    /// make_iterator_range(lattice_iterator<D>(min,max),false)
+    template <typename Iterator, typename End>
+    explicit grid(const iterator_range<Iterator,End>& range, 
+                  const T& value=T()):
+        grid(range.begin().get_min(),range.begin().get_max(),value)
+    {}
+
+    const int_d& get_min() const { return m_min; }
+    const int_d& get_max() const { return m_max; }
+    const mapping_type& get_mapping() const { return m_mapping; }
+
+    /// the strides of the storage, for the layouts that have them (row_major, 
+    /// padded_row_major and column_major). Pass these to lattice_iterator to 
+    /// get offsets into data(), less get_mapping().get_origin()
+    const std::array<Index,D>& get_stride() const { 
+        return m_mapping.get_stride(); 
+    }
+
+    /// iterates over every point of the grid in row-major order
+    iterator_range<iterator,bool> range() const {
+        return iterator_range<iterator,bool>(iterator(m_min,m_max),false);
+    }
+
+    /// the number of stored elements, including any padding of the layout
+    size_t size() const { return m_data.size(); }
+    T* data() { return m_data.data(); }
+    const T* data() const { return m_data.data(); }
+
+    reference operator[](const int_d& index) {
+        return m_data[m_mapping(index)];
+    }
+
+    const_reference operator[](const int_d& index) const {
+        return m_data[m_mapping(index)];
+    }
+
+    /// uses the linear offset of it if it has the strides of the storage 
+    /// (see get_stride()), otherwise the offset of *it
+    template <typename Iterator>
+    reference operator[](const Iterator& it) {
+        return m_data[detail::storage_offset<Index>(m_mapping,it,0)];
+    }
+
+    template <typename Iterator>
+    const_reference operator[](const Iterator& it) const {
+        return m_data[detail::storage_offset<Index>(m_mapping,it,0)];
+    }
+
+    /// calls f(index,value) for every point of the grid in storage order
+    template <typename F>
+    void for_each(F f) {
+        T* data = m_data.data();
+        m_mapping.for_each([&](const int_d& index, const Index offset) {
+            f(index,data[offset]);
+        });
+    }
+
+    template <typename F>
+    void for_each(F f) const {
+        const T* data = m_data.data();
+        m_mapping.for_each([&](const int_d& index, const Index offset) {
+            f(index,data[offset]);
+        });
+    }
+};
+
+}
+
+#endif
@@ -0,0 +1,125 @@
+/*
+
+Copyright (c) 2005-2016, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Aboria.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+#ifndef HALF_SHELL_H_ 
+#define HALF_SHELL_H_ 
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include "lattice_iterator.h"
+#include "periodic_lattice_iterator.h"
+
+namespace lattice {
+
+namespace detail {
+
+constexpr std::size_t power_of_three(const unsigned int n) {
+    return n == 0 ? 1 : 3*power_of_three(n-1);
+}
+
+}
+
+/// the number of neighbours in the forward half shell of a cell, (3^D-1)/2
+template <unsigned int D>
+constexpr std::size_t half_shell_size() {
+    return (detail::power_of_three(D)-1)/2;
+}
+
+/// an iterator over the forward half of the 3^D-1 neighbours of cell in the 
+/// box [min,max), i.e. the neighbours that come after cell in row-major 
+/// (lexicographic) order. Every pair of neighbouring cells is visited once 
+/// from its first cell, so a symmetric pair interaction (Newton's third law) 
+/// can update both cells and do half the work of a full shell. It is a 
+/// lattice_iterator over the 3^D neighbourhood of cell clipped to the box, 
+/// started one past cell, so offsets use stride
+template <std::size_t D, typename Coord, typename Index>
+lattice_iterator<D,Coord,Index> half_shell_begin(
+        const std::array<Coord,D>& cell,
+        const std::array<Coord,D>& min, 
+        const std::array<Coord,D>& max,
+        const std::array<Index,D>& stride) {
+    std::array<Coord,D> box_min, box_max;
+    Index position = 0;
+    for (size_t i = 0; i < D; ++i) {
+        assert(cell[i] >= min[i] && cell[i] < max[i]);
+        box_min[i] = std::max(min[i],cell[i]-1);
+        box_max[i] = std::min(max[i],cell[i]+2);
+        position = position*(box_max[i]-box_min[i]) + (cell[i]-box_min[i]);
+    }
+    return lattice_iterator<D,Coord,Index>(box_min,box_max,stride) + (position+1);
+}
+
+template <std::size_t D, typename Coord>
+lattice_iterator<D,Coord> half_shell_begin(const std::array<Coord,D>& cell,
+                                           const std::array<Coord,D>& min, 
+                                           const std::array<Coord,D>& max) {
+    return half_shell_begin(cell,min,max,
+                            lattice_iterator<D,Coord>(min,max).get_stride());
+}
+
+/// as half_shell_begin, with periodic boundaries on [min,max), so every 
+/// cell has (3^D-1)/2 forward neighbours and the coordinates and offsets of 
+/// those across the boundary are wrapped. Each dimension needs at least 3 
+/// cells, otherwise a pair of cells would be neighbours twice
+template <std::size_t D, typename Coord, typename Index>
+periodic_lattice_iterator<D,Coord,Index> periodic_half_shell_begin(
+        const std::array<Coord,D>& cell,
+        const std::array<Coord,D>& min, 
+        const std::array<Coord,D>& max,
+        const std::array<Index,D>& stride) {
+    std::array<Coord,D> box_min, box_max;
+    for (size_t i = 0; i < D; ++i) {
+        assert(max[i]-min[i] >= 3);
+        box_min[i] = cell[i]-1;
+        box_max[i] = cell[i]+2;
+    }
+    return periodic_lattice_iterator<D,Coord,Index>(min,max,box_min,box_max,
+                                                    stride) 
+            + static_cast<Index>(half_shell_size<D>()+1);
+}
+
+template <std::size_t D, typename Coord>
+periodic_lattice_iterator<D,Coord> periodic_half_shell_begin(
+        const std::array<Coord,D>& cell,
+        const std::array<Coord,D>& min, 
+        const std::array<Coord,D>& max) {
+    return periodic_half_shell_begin(cell,min,max,
+                            lattice_iterator<D,Coord>(min,max).get_stride());
+}
+
+}
+
+#endif
@@ -0,0 +1,205 @@
+/*
+
+Copyright (c) 2005-2016, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Aboria.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+#ifndef HALO_GRID_H_ 
+#define HALO_GRID_H_ 
+
+#include <array>
+#include <vector>
+#include "grid.h"
+#include "lattice_iterator.h"
+#include "range.h"
+
+namespace lattice {
+
+namespace detail {
+
+// the storage strides of mapping m if its layout has them, otherwise 
+// row-major strides for the box [min,max)
+template <typename Index, typename Mapping, typename Coord, std::size_t D>
+auto storage_stride(const Mapping& m, const std::array<Coord,D>&, 
+                    const std::array<Coord,D>&, int) 
+    -> decltype(m.get_stride()) {
+    return m.get_stride();
+}
+
+template <typename Index, typename Mapping, typename Coord, std::size_t D>
+std::array<Index,D> storage_stride(const Mapping&, 
+                                   const std::array<Coord,D>& min, 
+                                   const std::array<Coord,D>& max, long) {
+    return lattice_iterator<D,Coord,Index>(min,max).get_stride();
+}
+
+}
+
+/// a grid over the box [min,max) surrounded by a halo (ghost cells) of the 
+/// given width in each dimension. interior() is the box itself, so a 
+/// stencil sweep over it can read up to width points outside without any 
+/// boundary checks. The halo is split into 3^D-1 boxes: one for each face, 
+/// edge and corner (in 3D), given by region(). All the ranges use the 
+/// strides of the storage (for layouts that have them), so size_t(it) is 
+/// get_mapping().get_origin() plus the offset into data()
+template <typename T, unsigned int D, typename Layout=row_major, 
+          typename Coord=int, typename Index=std::ptrdiff_t>
+class halo_grid: public grid<T,D,Layout,Coord,Index> {
+    typedef grid<T,D,Layout,Coord,Index> base;
+
+public:
+    typedef std::array<Coord,D> int_d;
+    typedef lattice_iterator<D,Coord,Index> iterator;
+    typedef typename iterator::stride_type stride_type;
+    typedef iterator_range<iterator,bool> range_type;
+
+private:
+    int_d m_interior_min;
+    int_d m_interior_max;
+    int_d m_width;
+    stride_type m_stride;
+
+    static int_d extend(const int_d& arg, const int_d& width, const int sign) {
+        int_d ret;
+        for (size_t i = 0; i < D; ++i) {
+            ret[i] = arg[i] + sign*width[i];
+        }
+        return ret;
+    }
+
+    static int_d fill(const Coord value) {
+        int_d ret;
+        ret.fill(value);
+        return ret;
+    }
+
+    // an iterator over an empty box starts at the end
+    range_type make_range(const int_d& min, const int_d& max) const {
+        return range_type(iterator(min,max,m_stride),false);
+    }
+
+public:
+    halo_grid(const int_d& min, const int_d& max, const int_d& width, 
+              const T& value=T()):
+        base(extend(min,width,-1),extend(max,width,1),value),
+        m_interior_min(min),
+        m_interior_max(max),
+        m_width(width),
+        m_stride(detail::storage_stride<Index>(this->get_mapping(),
+                                        this->get_min(),this->get_max(),0))
+    {}
+
+    halo_grid(const int_d& min, const int_d& max, const Coord width, 
+              const T& value=T()):
+        halo_grid(min,max,fill(width),value)
+    {}
+
+    /// a halo grid whose interior is the box of range
+    template <typename Iterator, typename End>
+    halo_grid(const iterator_range<Iterator,End>& range, const Coord width, 
+              const T& value=T()):
+        halo_grid(range.begin().get_min(),range.begin().get_max(),
+                  fill(width),value)
+    {}
+
+    const int_d& get_width() const { return m_width; }
+    const int_d& get_interior_min() const { return m_interior_min; }
+    const int_d& get_interior_max() const { return m_interior_max; }
+
+    /// the strides used by all the ranges below
+    const stride_type& get_stride() const { return m_stride; }
+
+    /// every point, including the halo
+    range_type all() const {
+        return make_range(this->get_min(),this->get_max());
+    }
+
+    /// every point except the halo
+    range_type interior() const {
+        return make_range(m_interior_min,m_interior_max);
+    }
+
+    /// the part of the halo in direction dir, where each dir[i] is -1 
+    /// (below the interior), 0 (alongside it) or 1 (above it). For example 
+    /// in 3D {{-1,0,0}} is a face, {{-1,1,0}} an edge and {{-1,1,1}} a 
+    /// corner. dir = 0 gives interior()
+    range_type region(const std::array<int,D>& dir) const {
+        int_d min, max;
+        for (size_t i = 0; i < D; ++i) {
+            if (dir[i] < 0) {
+                min[i] = this->get_min()[i];
+                max[i] = m_interior_min[i];
+            } else if (dir[i] > 0) {
+                min[i] = m_interior_max[i];
+                max[i] = this->get_max()[i];
+            } else {
+                min[i] = m_interior_min[i];
+                max[i] = m_interior_max[i];
+            }
+        }
+        return make_range(min,max);
+    }
+
+    /// the halo next to the face of the interior normal to dimension d, 
+    /// on the low (side < 0) or high (side > 0) side
+    range_type face(const unsigned int d, const int side) const {
+        std::array<int,D> dir;
+        dir.fill(0);
+        dir[d] = side < 0 ? -1 : 1;
+        return region(dir);
+    }
+
+    /// the 3^D-1 disjoint regions that make up the halo, faces first, then 
+    /// edges, then corners
+    std::vector<range_type> halo() const {
+        std::vector<range_type> ret;
+        for (unsigned int nonzero = 1; nonzero <= D; ++nonzero) {
+            std::array<int,D> dir;
+            for (dir.fill(-1);;) {
+                unsigned int count = 0;
+                for (size_t i = 0; i < D; ++i) {
+                    if (dir[i] != 0) ++count;
+                }
+                if (count == nonzero) ret.push_back(region(dir));
+                // next direction in {-1,0,1}^D
+                size_t i = D;
+                while (i > 0 && dir[i-1] == 1) dir[--i] = -1;
+                if (i == 0) break;
+                ++dir[i-1];
+            }
+        }
+        return ret;
+    }
+};
+
+}
+
+#endif
@@ -0,0 +1,140 @@
+/*
+
+Copyright (c) 2005-2016, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Aboria.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+#ifndef HILBERT_H_ 
+#define HILBERT_H_ 
+
+#include <array>
+#include <cstdint>
+#include "morton.h"
+
+namespace lattice {
+
+namespace detail {
+
+// converts coordinates in place to the "transposed" Hilbert index of 
+// Skilling (2004), "Programming the Hilbert curve", AIP Conf. Proc. 707. 
+// The transposed form interleaved with dimension 0 as the most significant 
+// bit of each group is the Hilbert index, which is exactly morton_encode()
+template <unsigned int D>
+void hilbert_axes_to_transpose(std::array<std::uint64_t,D>& x, 
+                               const unsigned int bits) {
+    const std::uint64_t m = std::uint64_t(1) << (bits-1);
+    // inverse undo
+    for (std::uint64_t q = m; q > 1; q >>= 1) {
+        const std::uint64_t p = q-1;
+        for (size_t i = 0; i < D; ++i) {
+            if (x[i] & q) {
+                x[0] ^= p;
+            } else {
+                const std::uint64_t t = (x[0] ^ x[i]) & p;
+                x[0] ^= t;
+                x[i] ^= t;
+            }
+        }
+    }
+    // gray encode
+    for (size_t i = 1; i < D; ++i) {
+        x[i] ^= x[i-1];
+    }
+    std::uint64_t t = 0;
+    for (std::uint64_t q = m; q > 1; q >>= 1) {
+        if (x[D-1] & q) t ^= q-1;
+    }
+    for (size_t i = 0; i < D; ++i) {
+        x[i] ^= t;
+    }
+}
+
+// the inverse of hilbert_axes_to_transpose
+template <unsigned int D>
+void hilbert_transpose_to_axes(std::array<std::uint64_t,D>& x, 
+                               const unsigned int bits) {
+    const std::uint64_t n = std::uint64_t(1) << (bits-1);
+    // gray decode
+    const std::uint64_t top = x[D-1] >> 1;
+    for (size_t i = D-1; i > 0; --i) {
+        x[i] ^= x[i-1];
+    }
+    x[0] ^= top;
+    // undo excess work
+    for (std::uint64_t q = 2; q != (n << 1) && q != 0; q <<= 1) {
+        const std::uint64_t p = q-1;
+        for (size_t i = D; i-- > 0;) {
+            if (x[i] & q) {
+                x[0] ^= p;
+            } else {
+                const std::uint64_t t = (x[0] ^ x[i]) & p;
+                x[0] ^= t;
+                x[i] ^= t;
+            }
+        }
+    }
+}
+
+}
+
+/// maps the (non-negative) coordinates of index, each less than 2^bits, to 
+/// their position along the D-dimensional Hilbert curve that fills the cube 
+/// [0,2^bits)^D. Consecutive Hilbert indices are always neighbouring points, 
+/// so any contiguous range of indices covers a compact region. bits must be 
+/// between 1 and morton_bits<D>(), and the curve (and so the index) depends 
+/// on bits, so use the same value for collapse and reassemble
+template <unsigned int D, typename Coord>
+std::uint64_t hilbert_collapse(const std::array<Coord,D>& index, 
+                               const unsigned int bits) {
+    std::array<std::uint64_t,D> x;
+    for (size_t i = 0; i < D; ++i) {
+        x[i] = static_cast<std::uint64_t>(index[i]);
+    }
+    detail::hilbert_axes_to_transpose<D>(x,bits);
+    return morton_encode<D>(x);
+}
+
+/// the inverse of hilbert_collapse
+template <unsigned int D, typename Coord=int>
+std::array<Coord,D> hilbert_reassemble(const std::uint64_t code, 
+                                       const unsigned int bits) {
+    std::array<std::uint64_t,D> x = morton_decode<D,std::uint64_t>(code);
+    detail::hilbert_transpose_to_axes<D>(x,bits);
+    std::array<Coord,D> index;
+    for (size_t i = 0; i < D; ++i) {
+        index[i] = static_cast<Coord>(x[i]);
+    }
+    return index;
+}
+
+}
+
+#endif
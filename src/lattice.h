@@ -36,6 +36,25 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define LATTICE_H_ 
 
 #include "lattice_iterator.h"
+#include "lattice_row_iterator.h"
+#include "static_lattice_iterator.h"
+#include "tiled_lattice_iterator.h"
+#include "morton_lattice_iterator.h"
+#include "hilbert_lattice_iterator.h"
+#include "lattice_shell_iterator.h"
+#include "coloured_lattice_iterator.h"
+#include "periodic_lattice_iterator.h"
+#include "lattice_ball_iterator.h"
+#include "half_shell.h"
+#include "simplex_iterator.h"
+#include "masked_lattice_range.h"
+#include "for_each.h"
 #include "range.h"
+#include "lattice_range.h"
+#include "parallel_for.h"
+#include "grid.h"
+#include "halo_grid.h"
+#include "stencil.h"
+#include "temporal_blocking.h"
 
 #endif
@@ -0,0 +1,464 @@
+/*
+
+Copyright (c) 2005-2016, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Aboria.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+#ifndef LATTICE_BALL_ITERATOR_H_ 
+#define LATTICE_BALL_ITERATOR_H_ 
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include "lattice_iterator.h"
+#include "for_each.h"
+
+namespace lattice {
+
+/// the norm used to measure the radius of a lattice_ball_iterator
+enum class ball_norm { l1, l2, linf };
+
+/// iterates over the points of the box [min,max) within radius of centre, 
+/// measured with the L2 (default), L1 or Linf norm, in row-major order. For 
+/// example, the cells of a cell list that can hold neighbours of a particle 
+/// in the centre cell. The span of each row (innermost dimension) inside the 
+/// ball is computed once as the row is entered, so no points outside the 
+/// ball are visited and an increment within a row is as cheap as for 
+/// lattice_iterator. In 3D a box-and-filter search over the bounding box of 
+/// an L2 ball visits about twice as many points. Construction allocates 
+/// nothing, so an iterator can be made for every query. Jumps and distances 
+/// sum the spans of the rows before the current one, so are O(number of rows)
+template <unsigned int D, typename Coord=int, typename Index=std::ptrdiff_t>
+class lattice_ball_iterator {
+    typedef lattice_ball_iterator<D,Coord,Index> iterator;
+    typedef std::array<Coord,D> int_d;
+
+public:
+    typedef typename lattice_iterator<D,Coord,Index>::stride_type stride_type;
+
+private:
+    int_d m_min;
+    int_d m_max;
+    int_d m_centre;
+    double m_radius;
+    ball_norm m_norm;
+    stride_type m_stride;
+    // the bounding box of the ball clipped to [min,max), over which the 
+    // outer coordinates of the rows range
+    int_d m_box_min;
+    int_d m_box_max;
+    int_d m_index;
+    // end of the current row
+    Coord m_row_end;
+    Index m_offset;
+    bool m_valid;
+
+public:
+    typedef const int_d* pointer;
+	typedef std::random_access_iterator_tag iterator_category;
+	typedef std::random_access_iterator_tag iterator_concept;
+    typedef const int_d reference;
+    typedef int_d value_type;
+	typedef Index difference_type;
+
+    lattice_ball_iterator():
+        m_min(),
+        m_max(),
+        m_centre(),
+        m_radius(0),
+        m_norm(ball_norm::l2),
+        m_stride(),
+        m_box_min(),
+        m_box_max(),
+        m_index(),
+        m_row_end(0),
+        m_offset(0),
+        m_valid(false)
+    {}
+
+    lattice_ball_iterator(const int_d &min, 
+                          const int_d &max,
+                          const int_d &centre,
+                          const double radius,
+                          const ball_norm norm=ball_norm::l2):
+        lattice_ball_iterator(min,max,centre,radius,norm,
+                lattice_iterator<D,Coord,Index>(min,max).get_stride())
+    {}
+
+    lattice_ball_iterator(const int_d &min, 
+                          const int_d &max,
+                          const int_d &centre,
+                          const double radius,
+                          const ball_norm norm,
+                          const stride_type &stride):
+        m_min(min),
+        m_max(max),
+        m_centre(centre),
+        m_radius(radius),
+        m_norm(norm),
+        m_stride(stride)
+    {
+        init();
+    }
+
+    const int_d& get_min() const { return m_min; }
+    const int_d& get_max() const { return m_max; }
+    const int_d& get_centre() const { return m_centre; }
+    double get_radius() const { return m_radius; }
+    ball_norm get_norm() const { return m_norm; }
+    const stride_type& get_stride() const { return m_stride; }
+
+    /// the innermost coordinate one past the end of the current row
+    Coord get_row_end() const { return m_row_end; }
+
+    explicit operator size_t() const {
+        return m_offset;
+    }
+
+    reference operator *() const {
+        return m_index;
+    }
+
+    pointer operator ->() const {
+        return &m_index;
+    }
+
+    reference operator [](const difference_type n) const {
+        return *(*this + n);
+    }
+
+    iterator& operator++() {
+        increment();
+        return *this;
+    }
+
+    iterator operator++(int) {
+        iterator tmp(*this);
+        operator++();
+        return tmp;
+    }
+
+    iterator& operator--() {
+        decrement();
+        return *this;
+    }
+
+    iterator operator--(int) {
+        iterator tmp(*this);
+        operator--();
+        return tmp;
+    }
+
+    iterator operator+(const difference_type n) const {
+        iterator tmp(*this);
+        tmp.increment(n);
+        return tmp;
+    }
+
+    iterator& operator+=(const difference_type n) {
+        increment(n);
+        return *this;
+    }
+
+    iterator& operator-=(const difference_type n) {
+        increment(-n);
+        return *this;
+    }
+
+    iterator operator-(const difference_type n) const {
+        iterator tmp(*this);
+        tmp.increment(-n);
+        return tmp;
+    }
+
+    difference_type operator-(const iterator& start) const {
+        if (!m_valid) {
+            if (!start.m_valid) return 0;
+            return start.ball_size() - start.linear_position();
+        } else if (!start.m_valid) {
+            return linear_position() - ball_size();
+        } else {
+            return linear_position() - start.linear_position();
+        }
+    }
+
+    inline bool operator<(const iterator& rhs) const {
+        return *this - rhs < 0;
+    }
+
+    inline bool operator>(const iterator& rhs) const {
+        return rhs < *this;
+    }
+
+    inline bool operator<=(const iterator& rhs) const {
+        return !(rhs < *this);
+    }
+
+    inline bool operator>=(const iterator& rhs) const {
+        return !(*this < rhs);
+    }
+
+    inline bool operator==(const iterator& rhs) const {
+        if (!rhs.m_valid) return !m_valid;
+        if (!m_valid) return !rhs.m_valid;
+        return m_index == rhs.m_index;
+    }
+
+    inline bool operator==(const bool rhs) const {
+        return m_valid==rhs;
+    }
+
+    inline bool operator!=(const iterator& rhs) const {
+        return !operator==(rhs);
+    }
+
+    inline bool operator!=(const bool rhs) const {
+        return !operator==(rhs);
+    }
+
+    template <unsigned int D2, typename Coord2, typename Index2, 
+              typename End, typename F>
+    friend void for_each(lattice_ball_iterator<D2,Coord2,Index2> begin, 
+                         const End& end, F f);
+
+private:
+    // moves to the first point of the next row in the ball
+    void next_row() {
+        m_valid = first_row_from(next_outer());
+    }
+
+    // the largest h such that the points centre +- h along the innermost 
+    // dimension are in the ball, given the outer coordinates of index, or 
+    // -1 if there are none
+    Coord half_width(const int_d& index) const {
+        // the L1, squared L2 or Linf distance of the outer coordinates
+        double outer = 0;
+        for (size_t i = 0; i+1 < D; ++i) {
+            const double d = std::abs(static_cast<double>(index[i])-m_centre[i]);
+            switch (m_norm) {
+                case ball_norm::l1: outer += d; break;
+                case ball_norm::l2: outer += d*d; break;
+                case ball_norm::linf: outer = std::max(outer,d); break;
+            }
+        }
+        switch (m_norm) {
+            case ball_norm::l1: {
+                if (outer > m_radius) return -1;
+                return static_cast<Coord>(std::floor(m_radius - outer));
+            }
+            case ball_norm::linf: {
+                if (outer > m_radius) return -1;
+                return static_cast<Coord>(std::floor(m_radius));
+            }
+            default: {
+                // h^2 <= r^2 - outer, checked exactly around the floating 
+                // point square root
+                const double squared = m_radius*m_radius - outer;
+                if (squared < 0) return -1;
+                Coord h = static_cast<Coord>(std::sqrt(squared));
+                while (static_cast<double>(h+1)*(h+1) <= squared) ++h;
+                while (h > 0 && static_cast<double>(h)*h > squared) --h;
+                return h;
+            }
+        }
+    }
+
+    // the span [begin,end) of the row through index, clipped to the box
+    void row_span(const int_d& index, Coord& begin, Coord& end) const {
+        const Coord h = half_width(index);
+        begin = std::max(m_box_min[D-1],m_centre[D-1]-h);
+        end = std::min(m_box_max[D-1],m_centre[D-1]+h+1);
+    }
+
+    // advances the outer coordinates of m_index to the next row of the 
+    // bounding box, returning false if there are none
+    bool next_outer() {
+        for (int i = static_cast<int>(D)-2; i >= 0; --i) {
+            if (++m_index[i] < m_box_max[i]) return true;
+            m_index[i] = m_box_min[i];
+        }
+        return false;
+    }
+
+    // moves to the first point of the first non-empty row at or after the 
+    // outer coordinates of m_index, returning false if there are none
+    bool first_row_from(bool more) {
+        for (; more; more = next_outer()) {
+            Coord begin;
+            row_span(m_index,begin,m_row_end);
+            if (begin < m_row_end) {
+                m_index[D-1] = begin;
+                m_offset = 0;
+                for (size_t i = 0; i < D; ++i) {
+                    m_offset += m_stride[i]*m_index[i];
+                }
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void init() {
+        assert(m_radius >= 0);
+        const Coord r = static_cast<Coord>(std::floor(m_radius));
+        bool empty = false;
+        for (size_t i = 0; i < D; ++i) {
+            m_box_min[i] = std::max(m_min[i],m_centre[i]-r);
+            m_box_max[i] = std::min(m_max[i],m_centre[i]+r+1);
+            if (m_box_max[i] <= m_box_min[i]) empty = true;
+        }
+        m_index = m_box_min;
+        m_valid = first_row_from(!empty);
+    }
+
+    // calls f(index,begin,end) for each non-empty row in order, where index 
+    // gives its outer coordinates and [begin,end) its span, until f 
+    // returns false
+    template <typename F>
+    void for_each_row(F f) const {
+        int_d index = m_box_min;
+        for (size_t i = 0; i < D; ++i) {
+            if (m_box_max[i] <= m_box_min[i]) return;
+        }
+        for (;;) {
+            Coord begin, end;
+            row_span(index,begin,end);
+            if (begin < end && !f(index,begin,end)) return;
+            int i = static_cast<int>(D)-2;
+            for (; i >= 0; --i) {
+                if (++index[i] < m_box_max[i]) break;
+                index[i] = m_box_min[i];
+            }
+            if (i < 0) return;
+        }
+    }
+
+    Index ball_size() const {
+        Index size = 0;
+        for_each_row([&](const int_d&, const Coord begin, const Coord end) {
+            size += end - begin;
+            return true;
+        });
+        return size;
+    }
+
+    Index linear_position() const {
+        Index position = 0;
+        for_each_row([&](const int_d& index, const Coord begin, const Coord end) {
+            for (size_t i = 0; i+1 < D; ++i) {
+                if (index[i] != m_index[i]) {
+                    position += end - begin;
+                    return true;
+                }
+            }
+            position += m_index[D-1] - begin;
+            return false;
+        });
+        return position;
+    }
+
+    void set_linear_position(Index position) {
+        assert(position >= 0);
+        m_valid = false;
+        for_each_row([&](const int_d& index, const Coord begin, const Coord end) {
+            if (position >= end - begin) {
+                position -= end - begin;
+                return true;
+            }
+            m_index = index;
+            m_index[D-1] = begin + static_cast<Coord>(position);
+            m_row_end = end;
+            m_offset = 0;
+            for (size_t i = 0; i < D; ++i) {
+                m_offset += m_stride[i]*m_index[i];
+            }
+            m_valid = true;
+            return false;
+        });
+    }
+
+    void increment() {
+        ++m_index[D-1];
+        m_offset += m_stride[D-1];
+        if (m_index[D-1] == m_row_end) next_row();
+    }
+
+    void decrement() {
+        // a default constructed end iterator has an empty ball
+        assert(m_valid || ball_size() > 0);
+        if (!m_valid && ball_size() == 0) return;
+        increment(-1);
+    }
+
+    void increment(const Index n) {
+        set_linear_position((m_valid ? linear_position() : ball_size()) + n);
+    }
+};
+
+template <unsigned int D, typename Coord, typename Index>
+lattice_ball_iterator<D,Coord,Index> operator+(
+        const typename lattice_ball_iterator<D,Coord,Index>::difference_type n, 
+        const lattice_ball_iterator<D,Coord,Index>& it) {
+    return it + n;
+}
+
+/// calls f for every point in [begin,end), with a plain loop along each 
+/// row. As for for_each over a lattice_iterator, f is called as 
+/// f(index,offset) if it takes two arguments
+template <unsigned int D, typename Coord, typename Index, typename End, 
+          typename F>
+void for_each(lattice_ball_iterator<D,Coord,Index> begin, const End& end, 
+              F f) {
+    if (begin == false) return;
+    const Index inner_stride = begin.get_stride()[D-1];
+    // counting the points to end is O(rows), so only done for a partial ball
+    Index remaining = end == false ? std::numeric_limits<Index>::max()
+                                   : detail::distance_to(begin,end);
+    for (; begin != false && remaining > 0; begin.next_row()) {
+        std::array<Coord,D> index = *begin;
+        Index offset = static_cast<Index>(size_t(begin));
+        const Coord row_end = begin.get_row_end();
+        Coord last = row_end;
+        if (remaining < row_end - index[D-1]) {
+            last = index[D-1] + static_cast<Coord>(remaining);
+        }
+        remaining -= last - index[D-1];
+        for (; index[D-1] < last; ++index[D-1], offset += inner_stride) {
+            detail::call_with_offset(f,index,offset,0);
+        }
+    }
+}
+
+}
+
+#endif
@@ -39,51 +39,151 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <cmath>
 #include <cassert>
 #include <ostream>
+#include <iterator>
+#include <limits>
+#include "divider.h"
 
 namespace lattice {
 
-template <unsigned int D>
+/// iterates over the points of the D-dimensional box [min,max) in 
+/// row-major order, optionally taking every step[i]'th point along each 
+/// dimension. Coordinates are stored as Coord, linear offsets, positions 
+/// and distances are calculated using Index, so boxes with more than 2^31 
+/// points can be iterated with 32-bit coordinates. The default constructed 
+/// end iterator has no box, so it can be compared with and subtracted from 
+/// any iterator but not decremented. An iterator that has walked off the 
+/// end of its box (e.g. begin + size) can be decremented
+template <unsigned int D, typename Coord=int, typename Index=std::ptrdiff_t>
 class lattice_iterator {
-    typedef lattice_iterator<D> iterator;
+    typedef lattice_iterator<D,Coord,Index> iterator;
     typedef std::array<double,D> double_d;
-    typedef std::array<int,D> int_d;
+    typedef std::array<Coord,D> int_d;
     typedef std::array<size_t,D> size_d;
 
     int_d m_min;
     int_d m_max;
     int_d m_index;
+    // number of points along each dimension
     int_d m_size;
+    std::array<Index,D> m_stride;
+    int_d m_step;
+    // m_stride*m_step, the change in offset for one step
+    std::array<Index,D> m_step_stride;
+    Index m_offset;
+#ifdef LATTICE_FAST_DIVISION
+    std::array<divider,D> m_divider;
+#endif
     bool m_valid;
 public:
-    typedef const int_d pointer;
+    // dereferencing gives the index by value, so that references stay valid
+    // after the iterator is incremented or destroyed (as required by the 
+    // parallel algorithms of the standard library)
+    typedef const int_d* pointer;
 	typedef std::random_access_iterator_tag iterator_category;
-    typedef const int_d& reference;
-    typedef const int_d value_type;
-	typedef std::ptrdiff_t difference_type;
+	typedef std::random_access_iterator_tag iterator_concept;
+    typedef const int_d reference;
+    typedef int_d value_type;
+	typedef Index difference_type;
+    typedef std::array<Index,D> stride_type;
 
     lattice_iterator():
+        m_min(),
+        m_max(),
+        m_index(),
+        m_size(),
+        m_stride(),
+        m_step_stride(),
+        m_offset(0),
         m_valid(false)
-    {}
+    {
+        m_step.fill(1);
+    }
 
     lattice_iterator(const int_d &min, 
                      const int_d &max):
         m_min(min),
         m_max(max),
         m_index(min),
-        m_size(minus(max,min)),
-        m_valid(true)
-    {}
+        m_size(extent(min,max)),
+        m_valid(false)
+    {
+        m_step.fill(1);
+        m_stride[D-1] = 1;
+        for (int i = D-2; i >= 0; --i) {
+            m_stride[i] = checked_multiply(m_stride[i+1],m_size[i+1]);
+        }
+        init();
+    }
+
+    // iterate over [min,max), but calculate the linear offset using the 
+    // strides of a larger enclosing array (e.g. get_stride() of an iterator 
+    // over the whole array)
+    lattice_iterator(const int_d &min, 
+                     const int_d &max,
+                     const stride_type &stride):
+        m_min(min),
+        m_max(max),
+        m_index(min),
+        m_size(extent(min,max)),
+        m_stride(stride),
+        m_valid(false)
+    {
+        m_step.fill(1);
+        init();
+    }
+
+    // iterate over the points min + k*step in [min,max), e.g. the points of 
+    // a coarse multigrid level with step 2, with offsets calculated using 
+    // stride (e.g. get_stride() of an iterator over the whole fine grid)
+    lattice_iterator(const int_d &min, 
+                     const int_d &max,
+                     const stride_type &stride,
+                     const int_d &step):
+        m_min(min),
+        m_max(max),
+        m_index(min),
+        m_stride(stride),
+        m_step(step),
+        m_valid(false)
+    {
+        for (size_t i = 0; i < D; ++i) {
+            assert(m_step[i] > 0);
+            m_size[i] = m_max[i] > m_min[i] ? 
+                            (m_max[i]-m_min[i] + m_step[i]-1)/m_step[i] : 0;
+        }
+        init();
+    }
+
+    const int_d& get_min() const {
+        return m_min;
+    }
+
+    const int_d& get_max() const {
+        return m_max;
+    }
+
+    const stride_type& get_stride() const {
+        return m_stride;
+    }
+
+    const int_d& get_step() const {
+        return m_step;
+    }
 
     explicit operator size_t() const {
-        return collapse_index_vector(m_index);
+        return m_offset;
     }
 
     reference operator *() const {
         return dereference();
     }
 
-    reference operator ->() const {
-        return dereference();
+    pointer operator ->() const {
+        return &m_index;
+    }
+
+    reference operator [](const difference_type n) const {
+        return *(*this + n);
     }
 
     iterator& operator++() {
@@ -97,40 +197,66 @@ public:
         return tmp;
     }
 
-    iterator operator+(const int n) {
+    iterator& operator--() {
+        decrement();
+        return *this;
+    }
+
+    iterator operator--(int) {
+        iterator tmp(*this);
+        operator--();
+        return tmp;
+    }
+
+    iterator operator+(const difference_type n) const {
         iterator tmp(*this);
         tmp.increment(n);
         return tmp;
     }
 
-    iterator& operator+=(const int n) {
+    iterator& operator+=(const difference_type n) {
         increment(n);
         return *this;
     }
 
-    iterator& operator-=(const int n) {
+    iterator& operator-=(const difference_type n) {
         increment(-n);
         return *this;
     }
 
-    iterator operator-(const int n) {
+    iterator operator-(const difference_type n) const {
         iterator tmp(*this);
         tmp.increment(-n);
         return tmp;
     }
 
-    size_t operator-(const iterator& start) const {
-        int distance;
+    // the end iterator (default constructed, or incremented past the end 
+    // of the box) is one past the last point of any box
+    difference_type operator-(const iterator& start) const {
         if (!m_valid) {
-            const int_d test = minus(minus(start.m_max,1),start.m_index);
-            distance = start.collapse_index_vector(minus(minus(start.m_max,1),start.m_index))+1;
+            if (!start.m_valid) return 0;
+            return start.box_size() - start.linear_position();
         } else if (!start.m_valid) {
-            distance = collapse_index_vector(minus(m_index,m_min));
+            return linear_position() - box_size();
         } else {
-            distance = collapse_index_vector(minus(m_index,start.m_index));
+            return linear_position() - start.linear_position();
         }
-        assert(distance > 0);
-        return distance;
+    }
+
+    inline bool operator<(const iterator& rhs) const {
+        return *this - rhs < 0;
+    }
+
+    inline bool operator>(const iterator& rhs) const {
+        return rhs < *this;
+    }
+
+    inline bool operator<=(const iterator& rhs) const {
+        return !(rhs < *this);
+    }
+
+    inline bool operator>=(const iterator& rhs) const {
+        return !(*this < rhs);
     }
 
     inline bool operator==(const iterator& rhs) const {
@@ -151,6 +277,23 @@ public:
 
 private:
 
+    void init() {
+        // check that the number of points in the box fits in Index. An 
+        // empty box starts at the end
+        m_valid = box_size() > 0;
+        for (size_t i = 0; i < D; ++i) {
+            m_step_stride[i] = m_stride[i]*m_step[i];
+        }
+        m_offset = collapse_index_vector(m_index);
+#ifdef LATTICE_FAST_DIVISION
+        // an empty box is never divided into, but must not build a 
+        // divider by zero
+        for (size_t i = 0; i < D; ++i) {
+            m_divider[i] = m_size[i] > 0 ? divider(m_size[i]) : divider();
+        }
+#endif
+    }
+
     static inline 
     int_d minus(const int_d& arg1, const int_d& arg2) {
         int_d ret;
@@ -160,8 +303,18 @@ private:
         return ret;
     }
 
+    // number of points along each dimension of [min,max), zero if empty
     static inline 
-    int_d minus(const int_d& arg1, const int arg2) {
+    int_d extent(const int_d& min, const int_d& max) {
+        int_d ret;
+        for (size_t i = 0; i < D; ++i) {
+            ret[i] = max[i] > min[i] ? max[i]-min[i] : 0;
+        }
+        return ret;
+    }
+
+    static inline 
+    int_d minus(const int_d& arg1, const Coord arg2) {
         int_d ret;
         for (size_t i = 0; i < D; ++i) {
             ret[i] = arg1[i]-arg2;
@@ -169,27 +322,72 @@ private:
         return ret;
     }
 
-    int collapse_index_vector(const int_d &vindex) const {
-        int index = 0;
-        unsigned int multiplier = 1.0;
-        for (int i = D-1; i>=0; --i) {
-            if (i != D-1) {
-                multiplier *= m_size[i+1];
-            }
-            index += multiplier*vindex[i];
+    // a*b, asserting in debug builds that the result does not overflow Index
+    static inline
+    Index checked_multiply(const Index a, const Index b) {
+        assert(a == 0 || b <= std::numeric_limits<Index>::max()/a);
+        return a*b;
+    }
+
+    Index collapse_index_vector(const int_d &vindex) const {
+        Index index = 0;
+        for (size_t i = 0; i < D; ++i) {
+            index += m_stride[i]*vindex[i];
         }
         return index;
     }
 
-    int_d reassemble_index_vector(const int index) const {
-        int_d vindex;
-        int i = index;
-        for (int d = D-1; d>=0; --d) {
-            double div = (double)i / m_size[d];
-            vindex[d] = std::round((div-std::floor(div)) * m_size[d]);
-            i = std::floor(div);
+    // number of steps from m_min[i] to m_index[i]
+    Index steps(const size_t i) const {
+        const Index distance = static_cast<Index>(m_index[i])-m_min[i];
+        return m_step[i] == 1 ? distance : distance/m_step[i];
+    }
+
+    // position of m_index within the box, counting from m_min in 
+    // row-major order
+    Index linear_position() const {
+        Index position = steps(0);
+        for (size_t i = 1; i < D; ++i) {
+            position = position*m_size[i] + steps(i);
         }
-        return vindex;
+        return position;
+    }
+
+    Index box_size() const {
+        Index count = 1;
+        for (size_t i = 0; i < D; ++i) {
+            count = checked_multiply(count,m_size[i]);
+        }
+        return count;
+    }
+
+    // sets m_index from a position within the box using only integer 
+    // arithmetic (one division per dimension). Positions past the end of 
+    // the box give the same state as walking off the end with increment()
+    void set_linear_position(Index position) {
+        assert(position >= 0);
+        if (position >= box_size()) {
+            // one step past the last point along the step grid, as for 
+            // increment(), so that linear_position() is box_size()
+            m_index = m_min;
+            m_index[0] = m_min[0] + m_step[0]*m_size[0];
+            m_offset = collapse_index_vector(m_index);
+            m_valid = false;
+            return;
+        }
+        for (int i = D-1; i > 0; --i) {
+#ifdef LATTICE_FAST_DIVISION
+            const Index quotient = m_divider[i].divide(position);
+#else
+            const Index quotient = position / m_size[i];
+#endif
+            m_index[i] = m_min[i] + m_step[i]
+                * static_cast<Coord>(position - quotient*m_size[i]);
+            position = quotient;
+        }
+        m_index[0] = m_min[0] + m_step[0]*static_cast<Coord>(position);
+        m_offset = collapse_index_vector(m_index);
+        m_valid = true;
     }
 
     bool equal(iterator const& other) const {
@@ -207,28 +405,56 @@ private:
         return m_valid==other;
     }
 
-    reference dereference() const { 
+    const int_d& dereference() const { 
         return m_index; 
     }
 
     void increment() {
         for (int i=D-1; i>=0; --i) {
-            ++m_index[i];
+            m_index[i] += m_step[i];
+            m_offset += m_step_stride[i];
             if (m_index[i] < m_max[i]) break;
             if (i != 0) {
                 m_index[i] = m_min[i];
+                m_offset -= m_step_stride[i]*m_size[i];
             } else {
                 m_valid = false;
             }
         }
     }
 
-    void increment(const int n) {
-        int collapsed_index = collapse_index_vector(m_index);
-        m_index = reassemble_index_vector(collapsed_index += n);
+    void decrement() {
+        if (!m_valid) {
+            // a default constructed end iterator has an empty box
+            assert(box_size() > 0);
+            if (box_size() == 0) return;
+            set_linear_position(box_size()-1);
+            return;
+        }
+        for (int i=D-1; i>=0; --i) {
+            if (m_index[i] > m_min[i]) {
+                m_index[i] -= m_step[i];
+                m_offset -= m_step_stride[i];
+                return;
+            }
+            assert(i != 0);
+            m_index[i] = m_min[i] + m_step[i]*(m_size[i]-1);
+            m_offset += m_step_stride[i]*(m_size[i]-1);
+        }
+    }
+
+    void increment(const Index n) {
+        set_linear_position(linear_position() + n);
     }
 };
 
+template <unsigned int D, typename Coord, typename Index>
+lattice_iterator<D,Coord,Index> operator+(
+        const typename lattice_iterator<D,Coord,Index>::difference_type n, 
+        const lattice_iterator<D,Coord,Index>& it) {
+    return it + n;
+}
+
 }
 
 #endif
@@ -0,0 +1,168 @@
+/*
+
+Copyright (c) 2005-2016, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Aboria.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+#ifndef LATTICE_RANGE_H_ 
+#define LATTICE_RANGE_H_ 
+
+#include <cassert>
+#include "lattice_iterator.h"
+#include "for_each.h"
+
+namespace lattice {
+
+/// tag type for the splitting constructor of lattice_range. Any tag type can 
+/// be used, so tbb::split works as well
+struct split {};
+
+/// a splittable range over the box [min,max), following the TBB Range 
+/// concept so that it can be passed directly to tbb::parallel_for or used 
+/// to generate tasks for any other scheduler. Splitting cuts the box in two 
+/// along its longest dimension, so sub-ranges stay compact rather than 
+/// striding across rows. Linear offsets are calculated using the strides 
+/// of the original box (or the strides given in the constructor)
+template <unsigned int D, typename Coord=int, typename Index=std::ptrdiff_t>
+class lattice_range {
+    typedef std::array<Coord,D> int_d;
+public:
+    typedef lattice_iterator<D,Coord,Index> iterator;
+    typedef iterator const_iterator;
+    typedef typename iterator::stride_type stride_type;
+
+private:
+    int_d m_min;
+    int_d m_max;
+    stride_type m_stride;
+    Index m_grainsize;
+
+public:
+    lattice_range(const int_d &min, 
+                  const int_d &max,
+                  const Index grainsize=1):
+        m_min(min),
+        m_max(max),
+        m_stride(iterator(min,max).get_stride()),
+        m_grainsize(grainsize)
+    {}
+
+    lattice_range(const int_d &min, 
+                  const int_d &max,
+                  const stride_type &stride,
+                  const Index grainsize=1):
+        m_min(min),
+        m_max(max),
+        m_stride(stride),
+        m_grainsize(grainsize)
+    {}
+
+    /// the whole box of a lattice_iterator (which must have unit steps)
+    explicit lattice_range(const iterator &it, const Index grainsize=1):
+        m_min(it.get_min()),
+        m_max(it.get_max()),
+        m_stride(it.get_stride()),
+        m_grainsize(grainsize)
+    {
+        for (size_t i = 0; i < D; ++i) {
+            assert(it.get_step()[i] == 1);
+        }
+    }
+
+    /// splits r in two, r keeps the lower half of its longest dimension and 
+    /// this range takes the upper half
+    template <typename Split>
+    lattice_range(lattice_range &r, Split):
+        m_min(r.m_min),
+        m_max(r.m_max),
+        m_stride(r.m_stride),
+        m_grainsize(r.m_grainsize)
+    {
+        const unsigned int d = r.longest_dimension();
+        const Coord middle = r.m_min[d] + (r.m_max[d]-r.m_min[d])/2;
+        r.m_max[d] = middle;
+        m_min[d] = middle;
+    }
+
+    const int_d& get_min() const { return m_min; }
+    const int_d& get_max() const { return m_max; }
+    const stride_type& get_stride() const { return m_stride; }
+    Index grainsize() const { return m_grainsize; }
+
+    iterator begin() const { 
+        return iterator(m_min,m_max,m_stride); 
+    }
+
+    // the end iterator keeps the box, so that it can be decremented
+    iterator end() const { 
+        return begin() + size(); 
+    }
+
+    Index size() const {
+        Index count = 1;
+        for (size_t i = 0; i < D; ++i) {
+            if (m_max[i] <= m_min[i]) return 0;
+            count *= m_max[i]-m_min[i];
+        }
+        return count;
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+
+    bool is_divisible() const {
+        const unsigned int d = longest_dimension();
+        return size() > m_grainsize && m_max[d]-m_min[d] > 1;
+    }
+
+    /// calls f for every point in the range, see lattice::for_each
+    template <typename F>
+    void for_each(F f) const {
+        lattice::for_each(m_min,m_max,m_stride,f);
+    }
+
+private:
+    // ties go to the outermost dimension, so that rows are kept whole
+    unsigned int longest_dimension() const {
+        unsigned int longest = 0;
+        for (unsigned int i = 1; i < D; ++i) {
+            if (m_max[i]-m_min[i] > m_max[longest]-m_min[longest]) {
+                longest = i;
+            }
+        }
+        return longest;
+    }
+};
+
+}
+
+#endif
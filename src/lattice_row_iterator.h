@@ -0,0 +1,240 @@
+/*
+
+Copyright (c) 2005-2016, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Aboria.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+#ifndef LATTICE_ROW_ITERATOR_H_ 
+#define LATTICE_ROW_ITERATOR_H_ 
+
+#include <cassert>
+#include "lattice_iterator.h"
+
+namespace lattice {
+
+/// a contiguous run of points [begin,end) along the innermost dimension of a 
+/// lattice. index gives the outer coordinates, with index[D-1] == begin, and 
+/// offset is the linear offset of index. The linear offset of the point 
+/// with innermost coordinate i is offset + (i-begin)*stride
+template <unsigned int D, typename Coord=int, typename Index=std::ptrdiff_t>
+struct lattice_row {
+    std::array<Coord,D> index;
+    Coord begin;
+    Coord end;
+    Index offset;
+    Index stride;
+
+    Index size() const {
+        return end - begin;
+    }
+};
+
+/// iterates over the box [min,max) one innermost-dimension row at a time, 
+/// so that the carry logic of lattice_iterator is paid once per row and the 
+/// loop over each row can be vectorized. Internally this is a 
+/// lattice_iterator over the box with the innermost extent set to 1
+template <unsigned int D, typename Coord=int, typename Index=std::ptrdiff_t>
+class lattice_row_iterator {
+    typedef lattice_row_iterator<D,Coord,Index> iterator;
+    typedef lattice_iterator<D,Coord,Index> outer_iterator;
+    typedef std::array<Coord,D> int_d;
+
+    outer_iterator m_outer;
+    Coord m_end;
+public:
+    typedef lattice_row<D,Coord,Index> value_type;
+    typedef const value_type reference;
+
+    // rows are made on dereference, so operator-> returns a proxy that 
+    // holds the row by value
+    class pointer {
+        value_type m_row;
+    public:
+        explicit pointer(const value_type& row): m_row(row) {}
+        const value_type* operator ->() const { return &m_row; }
+    };
+
+	typedef std::random_access_iterator_tag iterator_category;
+	typedef std::random_access_iterator_tag iterator_concept;
+	typedef Index difference_type;
+    typedef typename outer_iterator::stride_type stride_type;
+
+    lattice_row_iterator():
+        m_outer(),
+        m_end(0)
+    {}
+
+    lattice_row_iterator(const int_d &min, 
+                         const int_d &max):
+        m_outer(min,row_max(min,max),outer_iterator(min,max).get_stride()),
+        m_end(max[D-1])
+    {}
+
+    lattice_row_iterator(const int_d &min, 
+                         const int_d &max,
+                         const stride_type &stride):
+        m_outer(min,row_max(min,max),stride),
+        m_end(max[D-1])
+    {}
+
+    /// iterate over the rows of the box of a lattice_iterator
+    explicit lattice_row_iterator(const outer_iterator &it):
+        m_outer(it.get_min(),row_max(it.get_min(),it.get_max()),
+                it.get_stride()),
+        m_end(it.get_max()[D-1])
+    {
+        for (size_t i = 0; i < D; ++i) {
+            assert(it.get_step()[i] == 1);
+        }
+    }
+
+    explicit operator size_t() const {
+        return size_t(m_outer);
+    }
+
+    reference operator *() const {
+        value_type row;
+        row.index = *m_outer;
+        row.begin = row.index[D-1];
+        row.end = m_end;
+        row.offset = static_cast<Index>(size_t(m_outer));
+        row.stride = m_outer.get_stride()[D-1];
+        return row;
+    }
+
+    pointer operator ->() const {
+        return pointer(operator*());
+    }
+
+    iterator& operator++() {
+        ++m_outer;
+        return *this;
+    }
+
+    iterator operator++(int) {
+        iterator tmp(*this);
+        operator++();
+        return tmp;
+    }
+
+    iterator& operator--() {
+        --m_outer;
+        return *this;
+    }
+
+    iterator operator--(int) {
+        iterator tmp(*this);
+        operator--();
+        return tmp;
+    }
+
+    iterator operator+(const difference_type n) const {
+        iterator tmp(*this);
+        tmp.m_outer += n;
+        return tmp;
+    }
+
+    iterator& operator+=(const difference_type n) {
+        m_outer += n;
+        return *this;
+    }
+
+    iterator& operator-=(const difference_type n) {
+        m_outer -= n;
+        return *this;
+    }
+
+    iterator operator-(const difference_type n) const {
+        iterator tmp(*this);
+        tmp.m_outer -= n;
+        return tmp;
+    }
+
+    reference operator [](const difference_type n) const {
+        return *(*this + n);
+    }
+
+    difference_type operator-(const iterator& start) const {
+        return m_outer - start.m_outer;
+    }
+
+    inline bool operator<(const iterator& rhs) const {
+        return *this - rhs < 0;
+    }
+
+    inline bool operator>(const iterator& rhs) const {
+        return rhs < *this;
+    }
+
+    inline bool operator<=(const iterator& rhs) const {
+        return !(rhs < *this);
+    }
+
+    inline bool operator>=(const iterator& rhs) const {
+        return !(*this < rhs);
+    }
+
+    inline bool operator==(const iterator& rhs) const {
+        return m_outer == rhs.m_outer;
+    }
+
+    inline bool operator==(const bool rhs) const {
+        return m_outer == rhs;
+    }
+
+    inline bool operator!=(const iterator& rhs) const {
+        return !operator==(rhs);
+    }
+
+    inline bool operator!=(const bool rhs) const {
+        return !operator==(rhs);
+    }
+
+private:
+    // an empty innermost extent gives an empty box, so that the iterator 
+    // starts at the end rather than visiting rows of length zero
+    static int_d row_max(const int_d& min, const int_d& max) {
+        int_d ret = max;
+        ret[D-1] = max[D-1] > min[D-1] ? min[D-1]+1 : min[D-1];
+        return ret;
+    }
+};
+
+template <unsigned int D, typename Coord, typename Index>
+lattice_row_iterator<D,Coord,Index> operator+(
+        const typename lattice_row_iterator<D,Coord,Index>::difference_type n, 
+        const lattice_row_iterator<D,Coord,Index>& it) {
+    return it + n;
+}
+
+}
+
+#endif
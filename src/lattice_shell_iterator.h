@@ -0,0 +1,380 @@
+/*
+
+Copyright (c) 2005-2016, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Aboria.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+#ifndef LATTICE_SHELL_ITERATOR_H_ 
+#define LATTICE_SHELL_ITERATOR_H_ 
+
+#include <cassert>
+#include "lattice_iterator.h"
+
+namespace lattice {
+
+/// iterates over the points of the box [min,max) that are within thickness 
+/// of its surface, i.e. that have at least one coordinate in 
+/// [min[i],min[i]+thickness) or [max[i]-thickness,max[i]). Points are 
+/// visited once each in row-major order, so boundary conditions can be 
+/// applied in O(n^(D-1)) instead of filtering all n^D points. Rows that 
+/// pass through the core of the box jump straight from the low side to the 
+/// high side, so an increment is O(1) apart from the usual carry at the end 
+/// of each row
+template <unsigned int D, typename Coord=int, typename Index=std::ptrdiff_t>
+class lattice_shell_iterator {
+    typedef lattice_shell_iterator<D,Coord,Index> iterator;
+    typedef std::array<Coord,D> int_d;
+
+public:
+    typedef typename lattice_iterator<D,Coord,Index>::stride_type stride_type;
+
+private:
+    int_d m_min;
+    int_d m_max;
+    int_d m_index;
+    int_d m_size;
+    // number of points along each dimension that are not in the shell
+    int_d m_core;
+    Coord m_thickness;
+    stride_type m_stride;
+    // number of points, and of core points, in the dimensions after d
+    stride_type m_volume;
+    stride_type m_core_volume;
+    Index m_offset;
+    // true if the outer coordinates of the current row are all in the core, 
+    // so that the row has a gap to jump over
+    bool m_core_row;
+    bool m_valid;
+
+public:
+    typedef const int_d* pointer;
+	typedef std::random_access_iterator_tag iterator_category;
+	typedef std::random_access_iterator_tag iterator_concept;
+    typedef const int_d reference;
+    typedef int_d value_type;
+	typedef Index difference_type;
+
+    lattice_shell_iterator():
+        m_min(),
+        m_max(),
+        m_index(),
+        m_size(),
+        m_core(),
+        m_thickness(1),
+        m_stride(),
+        m_volume(),
+        m_core_volume(),
+        m_offset(0),
+        m_core_row(false),
+        m_valid(false)
+    {}
+
+    lattice_shell_iterator(const int_d &min, 
+                           const int_d &max,
+                           const Coord thickness=1):
+        m_min(min),
+        m_max(max),
+        m_thickness(thickness),
+        m_stride(lattice_iterator<D,Coord,Index>(min,max).get_stride())
+    {
+        init();
+    }
+
+    lattice_shell_iterator(const int_d &min, 
+                           const int_d &max,
+                           const Coord thickness,
+                           const stride_type &stride):
+        m_min(min),
+        m_max(max),
+        m_thickness(thickness),
+        m_stride(stride)
+    {
+        init();
+    }
+
+    const int_d& get_min() const { return m_min; }
+    const int_d& get_max() const { return m_max; }
+    Coord get_thickness() const { return m_thickness; }
+    const stride_type& get_stride() const { return m_stride; }
+
+    explicit operator size_t() const {
+        return m_offset;
+    }
+
+    reference operator *() const {
+        return m_index;
+    }
+
+    pointer operator ->() const {
+        return &m_index;
+    }
+
+    reference operator [](const difference_type n) const {
+        return *(*this + n);
+    }
+
+    iterator& operator++() {
+        increment();
+        return *this;
+    }
+
+    iterator operator++(int) {
+        iterator tmp(*this);
+        operator++();
+        return tmp;
+    }
+
+    iterator& operator--() {
+        decrement();
+        return *this;
+    }
+
+    iterator operator--(int) {
+        iterator tmp(*this);
+        operator--();
+        return tmp;
+    }
+
+    iterator operator+(const difference_type n) const {
+        iterator tmp(*this);
+        tmp.increment(n);
+        return tmp;
+    }
+
+    iterator& operator+=(const difference_type n) {
+        increment(n);
+        return *this;
+    }
+
+    iterator& operator-=(const difference_type n) {
+        increment(-n);
+        return *this;
+    }
+
+    iterator operator-(const difference_type n) const {
+        iterator tmp(*this);
+        tmp.increment(-n);
+        return tmp;
+    }
+
+    difference_type operator-(const iterator& start) const {
+        if (!m_valid) {
+            if (!start.m_valid) return 0;
+            return start.shell_size() - start.linear_position();
+        } else if (!start.m_valid) {
+            return linear_position() - shell_size();
+        } else {
+            return linear_position() - start.linear_position();
+        }
+    }
+
+    inline bool operator<(const iterator& rhs) const {
+        return *this - rhs < 0;
+    }
+
+    inline bool operator>(const iterator& rhs) const {
+        return rhs < *this;
+    }
+
+    inline bool operator<=(const iterator& rhs) const {
+        return !(rhs < *this);
+    }
+
+    inline bool operator>=(const iterator& rhs) const {
+        return !(*this < rhs);
+    }
+
+    inline bool operator==(const iterator& rhs) const {
+        if (!rhs.m_valid) return !m_valid;
+        if (!m_valid) return !rhs.m_valid;
+        return m_index == rhs.m_index;
+    }
+
+    inline bool operator==(const bool rhs) const {
+        return m_valid==rhs;
+    }
+
+    inline bool operator!=(const iterator& rhs) const {
+        return !operator==(rhs);
+    }
+
+    inline bool operator!=(const bool rhs) const {
+        return !operator==(rhs);
+    }
+
+private:
+    void init() {
+        assert(m_thickness > 0);
+        m_valid = true;
+        for (size_t i = 0; i < D; ++i) {
+            m_size[i] = m_max[i]-m_min[i];
+            if (m_size[i] <= 0) m_valid = false;
+            m_core[i] = m_size[i] > 2*m_thickness ? m_size[i]-2*m_thickness : 0;
+        }
+        m_volume[D-1] = 1;
+        m_core_volume[D-1] = 1;
+        for (int i = D-2; i >= 0; --i) {
+            m_volume[i] = m_volume[i+1]*m_size[i+1];
+            m_core_volume[i] = m_core_volume[i+1]*m_core[i+1];
+        }
+        m_index = m_min;
+        m_offset = 0;
+        for (size_t i = 0; i < D; ++i) {
+            m_offset += m_stride[i]*m_index[i];
+        }
+        update_core_row();
+    }
+
+    bool in_core(const size_t i, const Coord index) const {
+        return index >= m_min[i]+m_thickness && index < m_max[i]-m_thickness;
+    }
+
+    void update_core_row() {
+        m_core_row = m_core[D-1] > 0;
+        for (size_t i = 0; i+1 < D; ++i) {
+            if (!in_core(i,m_index[i])) m_core_row = false;
+        }
+    }
+
+    Index shell_size() const {
+        return m_volume[0]*m_size[0] - m_core_volume[0]*m_core[0];
+    }
+
+    // the number of shell points before m_index in row-major order. For 
+    // each dimension d this counts the slabs below m_index[d] (with the 
+    // coordinates before d fixed), less their core points if the fixed 
+    // coordinates are all in the core
+    Index linear_position() const {
+        Index position = 0;
+        bool shell = false;
+        for (size_t d = 0; d < D; ++d) {
+            const Coord below = m_index[d]-m_min[d];
+            position += below*m_volume[d];
+            if (!shell) {
+                Coord core_below = below - m_thickness;
+                if (core_below < 0) core_below = 0;
+                if (core_below > m_core[d]) core_below = m_core[d];
+                position -= core_below*m_core_volume[d];
+            }
+            if (!in_core(d,m_index[d])) shell = true;
+        }
+        return position;
+    }
+
+    void set_linear_position(Index position) {
+        assert(position >= 0);
+        if (position >= shell_size()) {
+            m_valid = false;
+            return;
+        }
+        bool shell = false;
+        for (size_t d = 0; d < D; ++d) {
+            if (shell) {
+                const Index c = position/m_volume[d];
+                m_index[d] = m_min[d] + c;
+                position -= c*m_volume[d];
+                continue;
+            }
+            // m_index[d] falls in the low shell slabs, the core slabs (each 
+            // with m_volume-m_core_volume shell points) or the high slabs
+            const Index low = m_core[d] > 0 ? m_thickness : m_size[d];
+            const Index core_points = m_volume[d]-m_core_volume[d];
+            if (position < low*m_volume[d]) {
+                const Index c = position/m_volume[d];
+                m_index[d] = m_min[d] + c;
+                position -= c*m_volume[d];
+                shell = true;
+            } else if (position < low*m_volume[d] + m_core[d]*core_points) {
+                position -= low*m_volume[d];
+                const Index c = position/core_points;
+                m_index[d] = m_min[d] + low + c;
+                position -= c*core_points;
+            } else {
+                position -= low*m_volume[d] + m_core[d]*core_points;
+                const Index c = position/m_volume[d];
+                m_index[d] = m_min[d] + low + m_core[d] + c;
+                position -= c*m_volume[d];
+                shell = true;
+            }
+        }
+        m_offset = 0;
+        for (size_t i = 0; i < D; ++i) {
+            m_offset += m_stride[i]*m_index[i];
+        }
+        update_core_row();
+        m_valid = true;
+    }
+
+    void increment() {
+        ++m_index[D-1];
+        m_offset += m_stride[D-1];
+        if (m_core_row && m_index[D-1] == m_min[D-1]+m_thickness) {
+            m_index[D-1] += m_core[D-1];
+            m_offset += m_stride[D-1]*m_core[D-1];
+        }
+        if (m_index[D-1] < m_max[D-1]) return;
+        m_index[D-1] = m_min[D-1];
+        m_offset -= m_stride[D-1]*m_size[D-1];
+        for (int i = D-2; i >= 0; --i) {
+            ++m_index[i];
+            m_offset += m_stride[i];
+            if (m_index[i] < m_max[i]) {
+                update_core_row();
+                return;
+            }
+            m_index[i] = m_min[i];
+            m_offset -= m_stride[i]*m_size[i];
+        }
+        m_valid = false;
+    }
+
+    void decrement() {
+        // a default constructed end iterator has an empty shell
+        assert(m_valid || shell_size() > 0);
+        if (!m_valid && shell_size() == 0) return;
+        increment(-1);
+    }
+
+    void increment(const Index n) {
+        set_linear_position((m_valid ? linear_position() : shell_size()) + n);
+    }
+};
+
+template <unsigned int D, typename Coord, typename Index>
+lattice_shell_iterator<D,Coord,Index> operator+(
+        const typename lattice_shell_iterator<D,Coord,Index>::difference_type n, 
+        const lattice_shell_iterator<D,Coord,Index>& it) {
+    return it + n;
+}
+
+}
+
+#endif
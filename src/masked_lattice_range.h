@@ -0,0 +1,519 @@
+/*
+
+Copyright (c) 2005-2016, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Aboria.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+#ifndef MASKED_LATTICE_RANGE_H_ 
+#define MASKED_LATTICE_RANGE_H_ 
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "lattice_iterator.h"
+#include "for_each.h"
+#include "parallel_for.h"
+
+namespace lattice {
+
+namespace detail {
+
+inline unsigned int count_trailing_zeros(const uint64_t word) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(word);
+#else
+    unsigned int n = 0;
+    while (((word >> n) & 1) == 0) ++n;
+    return n;
+#endif
+}
+
+// the first position in [pos,end) whose bit in bits is value, or end. Whole 
+// words of the other value are skipped at once
+inline std::size_t find_bit(const std::vector<uint64_t>& bits, std::size_t pos, 
+                            const std::size_t end, const bool value) {
+    while (pos < end) {
+        const std::size_t w = pos/64;
+        uint64_t word = value ? bits[w] : ~bits[w];
+        word &= ~uint64_t(0) << (pos%64);
+        if (word != 0) {
+            return std::min(w*64 + count_trailing_zeros(word),end);
+        }
+        pos = (w+1)*64;
+    }
+    return end;
+}
+
+}
+
+/// a bitmap over the box [min,max) with bit p set if f(index) is true for 
+/// the p'th point in row-major order, in the format taken by 
+/// masked_lattice_range (bit p%64 of word p/64)
+template <typename Coord, std::size_t D, typename F>
+std::vector<uint64_t> make_lattice_mask(const std::array<Coord,D>& min,
+                                        const std::array<Coord,D>& max,
+                                        F f) {
+    lattice_iterator<D,Coord> begin(min,max);
+    const std::size_t size = lattice_iterator<D,Coord>() - begin;
+    std::vector<uint64_t> bits((size+63)/64,0);
+    std::size_t p = 0;
+    lattice::for_each(min,max,[&](const std::array<Coord,D>& index) {
+        if (f(index)) bits[p/64] |= uint64_t(1) << (p%64);
+        ++p;
+    });
+    return bits;
+}
+
+/// a run of active points along one row of a masked_lattice_range: the 
+/// points first, first+1, ... with inner coordinate < end. offset is the 
+/// linear offset of first and before the number of active points in the 
+/// spans before this one
+template <unsigned int D, typename Coord=int, typename Index=std::ptrdiff_t>
+struct lattice_span {
+    std::array<Coord,D> first;
+    Coord end;
+    Index offset;
+    Index before;
+};
+
+/// iterates over the active points of a masked_lattice_range in row-major 
+/// order, one run-length encoded span at a time. An increment within a 
+/// span is as cheap as for lattice_iterator, and jumps binary search the 
+/// spans. The spans are shared with the range, so copies are cheap
+template <unsigned int D, typename Coord=int, typename Index=std::ptrdiff_t>
+class masked_lattice_iterator {
+    typedef masked_lattice_iterator<D,Coord,Index> iterator;
+    typedef std::array<Coord,D> int_d;
+
+public:
+    typedef typename lattice_iterator<D,Coord,Index>::stride_type stride_type;
+    typedef lattice_span<D,Coord,Index> span_type;
+    typedef std::vector<span_type> spans_type;
+
+private:
+    std::shared_ptr<const spans_type> m_spans;
+    stride_type m_stride;
+    // total number of active points
+    Index m_size;
+    std::size_t m_span;
+    int_d m_index;
+    Index m_offset;
+    bool m_valid;
+
+public:
+    typedef const int_d* pointer;
+	typedef std::random_access_iterator_tag iterator_category;
+	typedef std::random_access_iterator_tag iterator_concept;
+    typedef const int_d reference;
+    typedef int_d value_type;
+	typedef Index difference_type;
+
+    masked_lattice_iterator():
+        m_spans(),
+        m_stride(),
+        m_size(0),
+        m_span(0),
+        m_index(),
+        m_offset(0),
+        m_valid(false)
+    {}
+
+    /// the first point of span number span (see masked_lattice_range)
+    masked_lattice_iterator(const std::shared_ptr<const spans_type>& spans,
+                            const stride_type& stride,
+                            const Index size, const std::size_t span):
+        m_spans(spans),
+        m_stride(stride),
+        m_size(size)
+    {
+        set_span(span);
+    }
+
+    const stride_type& get_stride() const { return m_stride; }
+
+    /// the index of the current span in get_spans()
+    std::size_t get_span() const { return m_span; }
+    const spans_type& get_spans() const { return *m_spans; }
+
+    explicit operator size_t() const {
+        return m_offset;
+    }
+
+    reference operator *() const {
+        return m_index;
+    }
+
+    pointer operator ->() const {
+        return &m_index;
+    }
+
+    reference operator [](const difference_type n) const {
+        return *(*this + n);
+    }
+
+    iterator& operator++() {
+        increment();
+        return *this;
+    }
+
+    iterator operator++(int) {
+        iterator tmp(*this);
+        operator++();
+        return tmp;
+    }
+
+    iterator& operator--() {
+        decrement();
+        return *this;
+    }
+
+    iterator operator--(int) {
+        iterator tmp(*this);
+        operator--();
+        return tmp;
+    }
+
+    iterator operator+(const difference_type n) const {
+        iterator tmp(*this);
+        tmp.increment(n);
+        return tmp;
+    }
+
+    iterator& operator+=(const difference_type n) {
+        increment(n);
+        return *this;
+    }
+
+    iterator& operator-=(const difference_type n) {
+        increment(-n);
+        return *this;
+    }
+
+    iterator operator-(const difference_type n) const {
+        iterator tmp(*this);
+        tmp.increment(-n);
+        return tmp;
+    }
+
+    difference_type operator-(const iterator& start) const {
+        if (!m_valid) {
+            if (!start.m_valid) return 0;
+            return start.m_size - start.linear_position();
+        } else if (!start.m_valid) {
+            return linear_position() - m_size;
+        } else {
+            return linear_position() - start.linear_position();
+        }
+    }
+
+    inline bool operator<(const iterator& rhs) const {
+        return *this - rhs < 0;
+    }
+
+    inline bool operator>(const iterator& rhs) const {
+        return rhs < *this;
+    }
+
+    inline bool operator<=(const iterator& rhs) const {
+        return !(rhs < *this);
+    }
+
+    inline bool operator>=(const iterator& rhs) const {
+        return !(*this < rhs);
+    }
+
+    inline bool operator==(const iterator& rhs) const {
+        if (!rhs.m_valid) return !m_valid;
+        if (!m_valid) return !rhs.m_valid;
+        return m_index == rhs.m_index;
+    }
+
+    inline bool operator==(const bool rhs) const {
+        return m_valid==rhs;
+    }
+
+    inline bool operator!=(const iterator& rhs) const {
+        return !operator==(rhs);
+    }
+
+    inline bool operator!=(const bool rhs) const {
+        return !operator==(rhs);
+    }
+
+private:
+    void set_span(const std::size_t span) {
+        m_span = span;
+        m_valid = m_span < m_spans->size();
+        if (m_valid) {
+            m_index = (*m_spans)[m_span].first;
+            m_offset = (*m_spans)[m_span].offset;
+        }
+    }
+
+    Index linear_position() const {
+        const span_type& span = (*m_spans)[m_span];
+        return span.before + (m_index[D-1]-span.first[D-1]);
+    }
+
+    void set_linear_position(const Index position) {
+        assert(position >= 0);
+        if (position >= m_size) {
+            m_valid = false;
+            return;
+        }
+        // the last span that starts at or before position
+        const auto it = std::upper_bound(m_spans->begin(),m_spans->end(),
+                position,[](const Index p, const span_type& span) { 
+                    return p < span.before; 
+                }) - 1;
+        set_span(it - m_spans->begin());
+        const Index n = position - it->before;
+        m_index[D-1] += n;
+        m_offset += n*m_stride[D-1];
+    }
+
+    void increment() {
+        ++m_index[D-1];
+        m_offset += m_stride[D-1];
+        if (m_index[D-1] == (*m_spans)[m_span].end) {
+            set_span(m_span+1);
+        }
+    }
+
+    void decrement() {
+        // a default constructed end iterator has no spans
+        assert(m_valid || m_size > 0);
+        if (!m_valid && m_size == 0) return;
+        increment(-1);
+    }
+
+    void increment(const Index n) {
+        set_linear_position((m_valid ? linear_position() : m_size) + n);
+    }
+};
+
+template <unsigned int D, typename Coord, typename Index>
+masked_lattice_iterator<D,Coord,Index> operator+(
+        const typename masked_lattice_iterator<D,Coord,Index>::difference_type n, 
+        const masked_lattice_iterator<D,Coord,Index>& it) {
+    return it + n;
+}
+
+/// a range over the active points of the box [min,max), given by a bitmap 
+/// with one bit per point in row-major order (see make_lattice_mask), e.g. 
+/// an irregular domain embedded in its bounding box. The constructor run 
+/// length encodes the bitmap into spans of active points along each row, 
+/// skipping whole words of inactive (or active) points at a time, so 
+/// iteration costs O(active points + spans) rather than the box volume. 
+/// Each point still gives its index and linear offset (using the strides of 
+/// the box, or those given), and size() is the number of active points. 
+/// The range is splittable for parallel_for or tbb::parallel_for: it is 
+/// cut between spans so that the halves have about the same number of 
+/// points
+template <unsigned int D, typename Coord=int, typename Index=std::ptrdiff_t>
+class masked_lattice_range {
+    typedef std::array<Coord,D> int_d;
+public:
+    typedef masked_lattice_iterator<D,Coord,Index> iterator;
+    typedef iterator const_iterator;
+    typedef typename iterator::stride_type stride_type;
+    typedef typename iterator::span_type span_type;
+    typedef typename iterator::spans_type spans_type;
+
+private:
+    int_d m_min;
+    int_d m_max;
+    stride_type m_stride;
+    std::shared_ptr<const spans_type> m_spans;
+    Index m_size;
+    // the spans [m_first,m_last) are in this range
+    std::size_t m_first;
+    std::size_t m_last;
+    Index m_grainsize;
+
+public:
+    masked_lattice_range(const int_d &min, 
+                         const int_d &max,
+                         const std::vector<uint64_t> &bitmap,
+                         const Index grainsize=1):
+        masked_lattice_range(min,max,
+                lattice_iterator<D,Coord,Index>(min,max).get_stride(),
+                bitmap,grainsize)
+    {}
+
+    masked_lattice_range(const int_d &min, 
+                         const int_d &max,
+                         const stride_type &stride,
+                         const std::vector<uint64_t> &bitmap,
+                         const Index grainsize=1):
+        m_min(min),
+        m_max(max),
+        m_stride(stride),
+        m_grainsize(grainsize)
+    {
+        encode(bitmap);
+    }
+
+    /// splits r in two, r keeps the spans before the middle point and this 
+    /// range takes the rest
+    template <typename Split>
+    masked_lattice_range(masked_lattice_range &r, Split):
+        m_min(r.m_min),
+        m_max(r.m_max),
+        m_stride(r.m_stride),
+        m_spans(r.m_spans),
+        m_size(r.m_size),
+        m_last(r.m_last),
+        m_grainsize(r.m_grainsize)
+    {
+        const Index middle = r.before(r.m_first) + r.size()/2;
+        const auto it = std::upper_bound(
+                m_spans->begin()+r.m_first+1,m_spans->begin()+r.m_last,middle,
+                [](const Index p, const span_type& span) { 
+                    return p < span.before; 
+                });
+        // both halves keep at least one span
+        m_first = std::min<std::size_t>(it - m_spans->begin(),r.m_last-1);
+        r.m_last = m_first;
+    }
+
+    const int_d& get_min() const { return m_min; }
+    const int_d& get_max() const { return m_max; }
+    const stride_type& get_stride() const { return m_stride; }
+    Index grainsize() const { return m_grainsize; }
+    void set_grainsize(const Index grainsize) { m_grainsize = grainsize; }
+
+    /// the run length encoded spans of active points of the whole box
+    const spans_type& get_spans() const { return *m_spans; }
+
+    iterator begin() const { 
+        return iterator(m_spans,m_stride,m_size,m_first); 
+    }
+
+    iterator end() const { 
+        return iterator(m_spans,m_stride,m_size,m_last); 
+    }
+
+    /// the number of active points
+    Index size() const {
+        return before(m_last) - before(m_first);
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+
+    bool is_divisible() const {
+        return size() > m_grainsize && m_last-m_first > 1;
+    }
+
+    /// calls f for every active point, as f(index,offset) if it takes two 
+    /// arguments, otherwise as f(index), with a plain loop along each span
+    template <typename F>
+    void for_each(F f) const {
+        const Index inner_stride = m_stride[D-1];
+        for (std::size_t s = m_first; s < m_last; ++s) {
+            const span_type& span = (*m_spans)[s];
+            int_d index = span.first;
+            Index offset = span.offset;
+            for (; index[D-1] < span.end; ++index[D-1], offset += inner_stride) {
+                detail::call_with_offset(f,index,offset,0);
+            }
+        }
+    }
+
+private:
+    Index before(const std::size_t span) const {
+        return span < m_spans->size() ? (*m_spans)[span].before : m_size;
+    }
+
+    void encode(const std::vector<uint64_t>& bitmap) {
+        std::shared_ptr<spans_type> spans = std::make_shared<spans_type>();
+        std::size_t total = 1;
+        for (size_t i = 0; i < D; ++i) {
+            total *= m_max[i] > m_min[i] ? m_max[i]-m_min[i] : 0;
+        }
+        assert(bitmap.size()*64 >= total);
+        const std::size_t row_length = total > 0 ? m_max[D-1]-m_min[D-1] : 1;
+        Index before = 0;
+        std::size_t pos = detail::find_bit(bitmap,0,total,true);
+        while (pos < total) {
+            // the span runs to the next inactive point or the end of the row
+            const std::size_t row = pos/row_length;
+            const std::size_t row_end = (row+1)*row_length;
+            const std::size_t end = detail::find_bit(bitmap,pos,row_end,false);
+            span_type span;
+            std::size_t r = row;
+            for (int i = D-2; i >= 0; --i) {
+                const std::size_t n = m_max[i]-m_min[i];
+                span.first[i] = m_min[i] + static_cast<Coord>(r % n);
+                r /= n;
+            }
+            span.first[D-1] = m_min[D-1] + static_cast<Coord>(pos - row*row_length);
+            span.end = m_min[D-1] + static_cast<Coord>(end - row*row_length);
+            span.offset = 0;
+            for (size_t i = 0; i < D; ++i) {
+                span.offset += m_stride[i]*span.first[i];
+            }
+            span.before = before;
+            before += end - pos;
+            spans->push_back(span);
+            pos = detail::find_bit(bitmap,end,total,true);
+        }
+        m_size = before;
+        m_first = 0;
+        m_last = spans->size();
+        m_spans = spans;
+    }
+};
+
+/// parallel_for over the active points of a masked_lattice_range, split 
+/// between spans into pieces with about the same number of active points
+template <unsigned int D, typename Coord, typename Index, typename F>
+void parallel_for(const masked_lattice_range<D,Coord,Index>& range, F f,
+                  const parallel_options<Index>& options = 
+                                            parallel_options<Index>()) {
+    typedef masked_lattice_range<D,Coord,Index> range_type;
+    thread_pool& pool = options.pool ? *options.pool : default_thread_pool();
+    detail::parallel_for_job<range_type,F> job(pool,f,range.size());
+    range_type piece(range);
+    piece.set_grainsize(options.grainsize);
+    job.run(piece);
+    pool.run_until([&job]() { return job.remaining == 0; });
+    if (job.error) std::rethrow_exception(job.error);
+}
+
+}
+
+#endif
@@ -0,0 +1,210 @@
+/*
+
+Copyright (c) 2005-2016, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Aboria.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+#ifndef MORTON_H_ 
+#define MORTON_H_ 
+
+#include <array>
+#include <cstdint>
+#ifdef __BMI2__
+#include <immintrin.h>
+#endif
+
+namespace lattice {
+
+namespace detail {
+
+// the bits of a D-dimensional Morton code that belong to dimension d. 
+// Dimension D-1 has the least significant bit, so that Morton order 
+// agrees with row-major order within each 2^D block. The bits k*D for 
+// k < 64/D are (2^(D*(64/D)) - 1)/(2^D - 1)
+template <unsigned int D>
+constexpr std::uint64_t morton_mask(const unsigned int d) {
+    return ((D*(64/D) == 64 ? ~std::uint64_t(0) 
+                            : (std::uint64_t(1) << (D*(64/D))) - 1)
+            / ((std::uint64_t(1) << D) - 1)) << (D-1-d);
+}
+
+// spreads the low 64/D bits of x out to every D'th bit, and the inverse. 
+// With BMI2 this is a single pdep or pext, otherwise D = 2 and D = 3 use 
+// the usual shift and mask sequences and other dimensions loop over the bits
+template <unsigned int D>
+struct morton_bits_impl {
+    static std::uint64_t spread(const std::uint64_t x) {
+#ifdef __BMI2__
+        return _pdep_u64(x,morton_mask<D>(D-1));
+#else
+        std::uint64_t ret = 0;
+        for (unsigned int bit = 0; bit < 64/D; ++bit) {
+            ret |= ((x >> bit) & 1) << (bit*D);
+        }
+        return ret;
+#endif
+    }
+
+    static std::uint64_t compact(const std::uint64_t x) {
+#ifdef __BMI2__
+        return _pext_u64(x,morton_mask<D>(D-1));
+#else
+        std::uint64_t ret = 0;
+        for (unsigned int bit = 0; bit < 64/D; ++bit) {
+            ret |= ((x >> (bit*D)) & 1) << bit;
+        }
+        return ret;
+#endif
+    }
+};
+
+#ifndef __BMI2__
+template <>
+struct morton_bits_impl<2> {
+    static std::uint64_t spread(std::uint64_t x) {
+        x &= 0x00000000ffffffffull;
+        x = (x | (x << 16)) & 0x0000ffff0000ffffull;
+        x = (x | (x << 8)) & 0x00ff00ff00ff00ffull;
+        x = (x | (x << 4)) & 0x0f0f0f0f0f0f0f0full;
+        x = (x | (x << 2)) & 0x3333333333333333ull;
+        x = (x | (x << 1)) & 0x5555555555555555ull;
+        return x;
+    }
+
+    static std::uint64_t compact(std::uint64_t x) {
+        x &= 0x5555555555555555ull;
+        x = (x | (x >> 1)) & 0x3333333333333333ull;
+        x = (x | (x >> 2)) & 0x0f0f0f0f0f0f0f0full;
+        x = (x | (x >> 4)) & 0x00ff00ff00ff00ffull;
+        x = (x | (x >> 8)) & 0x0000ffff0000ffffull;
+        x = (x | (x >> 16)) & 0x00000000ffffffffull;
+        return x;
+    }
+};
+
+template <>
+struct morton_bits_impl<3> {
+    static std::uint64_t spread(std::uint64_t x) {
+        x &= 0x00000000001fffffull;
+        x = (x | (x << 32)) & 0x001f00000000ffffull;
+        x = (x | (x << 16)) & 0x001f0000ff0000ffull;
+        x = (x | (x << 8)) & 0x100f00f00f00f00full;
+        x = (x | (x << 4)) & 0x10c30c30c30c30c3ull;
+        x = (x | (x << 2)) & 0x1249249249249249ull;
+        return x;
+    }
+
+    static std::uint64_t compact(std::uint64_t x) {
+        x &= 0x1249249249249249ull;
+        x = (x ^ (x >> 2)) & 0x10c30c30c30c30c3ull;
+        x = (x ^ (x >> 4)) & 0x100f00f00f00f00full;
+        x = (x ^ (x >> 8)) & 0x001f0000ff0000ffull;
+        x = (x ^ (x >> 16)) & 0x001f00000000ffffull;
+        x = (x ^ (x >> 32)) & 0x00000000001fffffull;
+        return x;
+    }
+};
+#endif
+
+}
+
+/// the number of bits per dimension available in a 64-bit Morton code
+template <unsigned int D>
+constexpr unsigned int morton_bits() {
+    return 64/D;
+}
+
+/// interleaves the bits of the (non-negative) coordinates of index into a 
+/// 64-bit Morton code, using the BMI2 pdep instruction if the compiler 
+/// targets it (e.g. -mbmi2 or -march=native) and portable bit twiddling 
+/// otherwise
+template <unsigned int D, typename Coord>
+std::uint64_t morton_encode(const std::array<Coord,D>& index) {
+    std::uint64_t code = 0;
+    for (unsigned int d = 0; d < D; ++d) {
+        code |= detail::morton_bits_impl<D>::spread(
+                    static_cast<std::uint64_t>(index[d])) << (D-1-d);
+    }
+    return code;
+}
+
+/// the inverse of morton_encode
+template <unsigned int D, typename Coord=int>
+std::array<Coord,D> morton_decode(const std::uint64_t code) {
+    std::array<Coord,D> index;
+    for (unsigned int d = 0; d < D; ++d) {
+        index[d] = static_cast<Coord>(
+                detail::morton_bits_impl<D>::compact(code >> (D-1-d)));
+    }
+    return index;
+}
+
+/// the smallest Morton code greater than code whose point lies in the box 
+/// with corners decoded from min_code and max_code (inclusive), or 
+/// max_code+1 if there is none. This is the BIGMIN calculation of Tropf & 
+/// Herzog (1981), generalised to D dimensions
+template <unsigned int D>
+std::uint64_t morton_next_in_box(const std::uint64_t code,
+                                 std::uint64_t min_code,
+                                 std::uint64_t max_code) {
+    const std::uint64_t end = max_code + 1;
+    std::uint64_t bigmin = end;
+    for (int bit = 63; bit >= 0; --bit) {
+        const std::uint64_t b = std::uint64_t(1) << bit;
+        const unsigned int d = D-1 - bit % D;
+        // this bit and the lower bits of the same dimension
+        const std::uint64_t lower = detail::morton_mask<D>(d) & (b | (b-1));
+        const std::uint64_t below = lower & ~b;
+        const unsigned int state = ((code & b) ? 4 : 0) 
+                                    | ((min_code & b) ? 2 : 0) 
+                                    | ((max_code & b) ? 1 : 0);
+        switch (state) {
+            case 1: // 0,0,1
+                bigmin = (min_code & ~lower) | b;
+                max_code = (max_code & ~lower) | below;
+                break;
+            case 3: // 0,1,1
+                return min_code;
+            case 4: // 1,0,0
+                return bigmin;
+            case 5: // 1,0,1
+                min_code = (min_code & ~lower) | b;
+                break;
+            default: // 0,0,0 and 1,1,1 (min > max is not possible)
+                break;
+        }
+    }
+    return bigmin;
+}
+
+}
+
+#endif
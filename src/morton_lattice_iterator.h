@@ -0,0 +1,375 @@
+/*
+
+Copyright (c) 2005-2016, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Aboria.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+#ifndef MORTON_LATTICE_ITERATOR_H_ 
+#define MORTON_LATTICE_ITERATOR_H_ 
+
+#include <cassert>
+#include "lattice_iterator.h"
+#include "morton.h"
+
+namespace lattice {
+
+/// iterates over the box [min,max) in Morton (Z-order), which keeps 
+/// neighbouring points close together in every dimension. Points are 
+/// ordered by the Morton code of index-min. If the box is not a 
+/// power-of-two cube the codes that fall outside it are skipped in one step 
+/// using morton_next_in_box(), so the cost of an increment does not depend 
+/// on the amount of padding. The box can have at most morton_bits<D>() bits 
+/// per dimension
+template <unsigned int D, typename Coord=int, typename Index=std::ptrdiff_t>
+class morton_lattice_iterator {
+    typedef morton_lattice_iterator<D,Coord,Index> iterator;
+    typedef std::array<Coord,D> int_d;
+    typedef std::uint64_t code_type;
+
+public:
+    typedef typename lattice_iterator<D,Coord,Index>::stride_type stride_type;
+
+private:
+    int_d m_min;
+    int_d m_max;
+    int_d m_size;
+    stride_type m_stride;
+    int_d m_index;
+    code_type m_code;
+    code_type m_max_code;
+    unsigned int m_levels;
+    Index m_offset;
+    bool m_valid;
+
+public:
+    typedef const int_d* pointer;
+	typedef std::random_access_iterator_tag iterator_category;
+	typedef std::random_access_iterator_tag iterator_concept;
+    typedef const int_d reference;
+    typedef int_d value_type;
+	typedef Index difference_type;
+
+    morton_lattice_iterator():
+        m_min(),
+        m_max(),
+        m_size(),
+        m_stride(),
+        m_index(),
+        m_code(0),
+        m_max_code(0),
+        m_levels(0),
+        m_offset(0),
+        m_valid(false)
+    {}
+
+    morton_lattice_iterator(const int_d &min, 
+                            const int_d &max):
+        m_min(min),
+        m_max(max),
+        m_stride(lattice_iterator<D,Coord,Index>(min,max).get_stride())
+    {
+        init();
+    }
+
+    morton_lattice_iterator(const int_d &min, 
+                            const int_d &max,
+                            const stride_type &stride):
+        m_min(min),
+        m_max(max),
+        m_stride(stride)
+    {
+        init();
+    }
+
+    const int_d& get_min() const { return m_min; }
+    const int_d& get_max() const { return m_max; }
+    const stride_type& get_stride() const { return m_stride; }
+
+    /// the Morton code of the current point, relative to min
+    code_type get_code() const { return m_code; }
+
+    explicit operator size_t() const {
+        return m_offset;
+    }
+
+    reference operator *() const {
+        return m_index;
+    }
+
+    pointer operator ->() const {
+        return &m_index;
+    }
+
+    reference operator [](const difference_type n) const {
+        return *(*this + n);
+    }
+
+    iterator& operator++() {
+        increment();
+        return *this;
+    }
+
+    iterator operator++(int) {
+        iterator tmp(*this);
+        operator++();
+        return tmp;
+    }
+
+    iterator& operator--() {
+        decrement();
+        return *this;
+    }
+
+    iterator operator--(int) {
+        iterator tmp(*this);
+        operator--();
+        return tmp;
+    }
+
+    iterator operator+(const difference_type n) const {
+        iterator tmp(*this);
+        tmp.increment(n);
+        return tmp;
+    }
+
+    iterator& operator+=(const difference_type n) {
+        increment(n);
+        return *this;
+    }
+
+    iterator& operator-=(const difference_type n) {
+        increment(-n);
+        return *this;
+    }
+
+    iterator operator-(const difference_type n) const {
+        iterator tmp(*this);
+        tmp.increment(-n);
+        return tmp;
+    }
+
+    difference_type operator-(const iterator& start) const {
+        if (!m_valid) {
+            if (!start.m_valid) return 0;
+            return start.box_size() - start.linear_position();
+        } else if (!start.m_valid) {
+            return linear_position() - box_size();
+        } else {
+            return linear_position() - start.linear_position();
+        }
+    }
+
+    inline bool operator<(const iterator& rhs) const {
+        return *this - rhs < 0;
+    }
+
+    inline bool operator>(const iterator& rhs) const {
+        return rhs < *this;
+    }
+
+    inline bool operator<=(const iterator& rhs) const {
+        return !(rhs < *this);
+    }
+
+    inline bool operator>=(const iterator& rhs) const {
+        return !(*this < rhs);
+    }
+
+    inline bool operator==(const iterator& rhs) const {
+        if (!rhs.m_valid) return !m_valid;
+        if (!m_valid) return !rhs.m_valid;
+        return m_code == rhs.m_code;
+    }
+
+    inline bool operator==(const bool rhs) const {
+        return m_valid==rhs;
+    }
+
+    inline bool operator!=(const iterator& rhs) const {
+        return !operator==(rhs);
+    }
+
+    inline bool operator!=(const bool rhs) const {
+        return !operator==(rhs);
+    }
+
+private:
+    void init() {
+        int_d last;
+        m_levels = 0;
+        m_valid = true;
+        for (size_t i = 0; i < D; ++i) {
+            m_size[i] = m_max[i]-m_min[i];
+            if (m_size[i] <= 0) m_valid = false;
+            last[i] = m_size[i]-1;
+            while (m_levels < morton_bits<D>() && 
+                   (code_type(1) << m_levels) < code_type(m_size[i])) {
+                ++m_levels;
+            }
+            // each dimension must fit in morton_bits<D>() bits
+            assert(!m_valid || m_levels == 64 ||
+                   (code_type(1) << m_levels) >= code_type(m_size[i]));
+        }
+        if (!m_valid) return;
+        m_max_code = morton_encode<D>(last);
+        set_code(0);
+    }
+
+    void set_code(const code_type code) {
+        set_code(code,morton_decode<D,Coord>(code));
+    }
+
+    void set_code(const code_type code, const int_d& relative) {
+        m_code = code;
+        m_offset = 0;
+        for (size_t i = 0; i < D; ++i) {
+            m_index[i] = m_min[i] + relative[i];
+            m_offset += m_stride[i]*m_index[i];
+        }
+    }
+
+    bool in_box(const int_d& relative) const {
+        for (size_t i = 0; i < D; ++i) {
+            if (relative[i] >= m_size[i]) return false;
+        }
+        return true;
+    }
+
+    Index box_size() const {
+        Index count = 1;
+        for (size_t i = 0; i < D; ++i) {
+            count *= m_size[i];
+        }
+        return count;
+    }
+
+    // number of points of the box inside the cube of side 2^level at origin
+    Index overlap(const int_d& origin, const unsigned int level) const {
+        Index count = 1;
+        for (size_t i = 0; i < D; ++i) {
+            const Index side = Index(1) << level;
+            const Index remaining = m_size[i] - origin[i];
+            if (remaining <= 0) return 0;
+            count *= remaining < side ? remaining : side;
+        }
+        return count;
+    }
+
+    // origin of child cube c (of side 2^level) of the cube at origin
+    static int_d child_origin(const int_d& origin, const unsigned int c, 
+                              const unsigned int level) {
+        int_d ret = origin;
+        for (size_t i = 0; i < D; ++i) {
+            if (c & (1u << (D-1-i))) ret[i] += Coord(1) << level;
+        }
+        return ret;
+    }
+
+    // the number of points in the box with a smaller code, found by 
+    // descending the 2^D-tree and adding up the children before the 
+    // current one at each level
+    Index linear_position() const {
+        Index position = 0;
+        int_d origin;
+        origin.fill(0);
+        for (int level = m_levels-1; level >= 0; --level) {
+            const unsigned int digit = (m_code >> (level*D)) & ((1u << D)-1);
+            for (unsigned int c = 0; c < digit; ++c) {
+                position += overlap(child_origin(origin,c,level),level);
+            }
+            origin = child_origin(origin,digit,level);
+        }
+        return position;
+    }
+
+    void set_linear_position(Index position) {
+        assert(position >= 0);
+        if (position >= box_size()) {
+            m_valid = false;
+            return;
+        }
+        code_type code = 0;
+        int_d origin;
+        origin.fill(0);
+        for (int level = m_levels-1; level >= 0; --level) {
+            unsigned int c = 0;
+            for (;; ++c) {
+                const Index count = overlap(child_origin(origin,c,level),level);
+                if (position < count) break;
+                position -= count;
+            }
+            code |= code_type(c) << (level*D);
+            origin = child_origin(origin,c,level);
+        }
+        set_code(code);
+        m_valid = true;
+    }
+
+    void increment() {
+        code_type code = m_code + 1;
+        if (code > m_max_code) {
+            m_valid = false;
+            return;
+        }
+        int_d relative = morton_decode<D,Coord>(code);
+        if (!in_box(relative)) {
+            code = morton_next_in_box<D>(code,0,m_max_code);
+            if (code > m_max_code) {
+                m_valid = false;
+                return;
+            }
+            relative = morton_decode<D,Coord>(code);
+        }
+        set_code(code,relative);
+    }
+
+    void decrement() {
+        // a default constructed end iterator has an empty box
+        assert(m_valid || box_size() > 0);
+        if (!m_valid && box_size() == 0) return;
+        increment(-1);
+    }
+
+    void increment(const Index n) {
+        set_linear_position((m_valid ? linear_position() : box_size()) + n);
+    }
+};
+
+template <unsigned int D, typename Coord, typename Index>
+morton_lattice_iterator<D,Coord,Index> operator+(
+        const typename morton_lattice_iterator<D,Coord,Index>::difference_type n, 
+        const morton_lattice_iterator<D,Coord,Index>& it) {
+    return it + n;
+}
+
+}
+
+#endif
@@ -0,0 +1,358 @@
+/*
+
+Copyright (c) 2005-2016, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Aboria.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+#ifndef PARALLEL_FOR_H_ 
+#define PARALLEL_FOR_H_ 
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "lattice_range.h"
+#include "range.h"
+
+namespace lattice {
+
+/// a small work-stealing thread pool. Each thread has its own task deque, 
+/// it pushes and pops tasks at the back and steals from the front of the 
+/// other deques when its own is empty. The thread that waits for a set of 
+/// tasks (see run_until()) executes tasks as well, so a pool of n threads 
+/// starts n-1 worker threads. The workers are reused until the pool is 
+/// destroyed
+class thread_pool {
+    typedef std::function<void()> task_type;
+
+    struct task_queue {
+        std::mutex mutex;
+        std::deque<task_type> tasks;
+    };
+
+    std::vector<std::unique_ptr<task_queue>> m_queues;
+    std::vector<std::thread> m_threads;
+    std::atomic<int> m_queued;
+    std::atomic<bool> m_stop;
+    std::mutex m_sleep_mutex;
+    std::condition_variable m_wake;
+
+public:
+    explicit thread_pool(const unsigned int nthreads = default_threads()):
+        m_queued(0),
+        m_stop(false)
+    {
+        const unsigned int n = nthreads > 0 ? nthreads : 1;
+        for (unsigned int i = 0; i < n; ++i) {
+            m_queues.emplace_back(new task_queue());
+        }
+        // queue 0 is shared by all threads outside the pool
+        for (unsigned int i = 1; i < n; ++i) {
+            m_threads.emplace_back([this,i]() { worker(i); });
+        }
+    }
+
+    ~thread_pool() {
+        {
+            std::lock_guard<std::mutex> lock(m_sleep_mutex);
+            m_stop = true;
+        }
+        m_wake.notify_all();
+        for (auto& thread: m_threads) {
+            thread.join();
+        }
+    }
+
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+
+    unsigned int size() const {
+        return m_queues.size();
+    }
+
+    /// adds a task to the calling thread's deque
+    void push(task_type task) {
+        task_queue& queue = *m_queues[this_queue()];
+        {
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.tasks.push_back(std::move(task));
+        }
+        ++m_queued;
+        if (!m_threads.empty()) {
+            // a worker that has just found no tasks checks m_queued while 
+            // holding m_sleep_mutex, so take it to avoid a lost wakeup
+            { std::lock_guard<std::mutex> lock(m_sleep_mutex); }
+            m_wake.notify_one();
+        }
+    }
+
+    /// executes tasks on the calling thread until done() returns true
+    template <typename Predicate>
+    void run_until(Predicate done) {
+        const unsigned int queue = this_queue();
+        while (!done()) {
+            if (!run_one(queue)) {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    static unsigned int default_threads() {
+        const unsigned int n = std::thread::hardware_concurrency();
+        return n > 0 ? n : 1;
+    }
+
+private:
+    static unsigned int& thread_queue() {
+        static thread_local unsigned int queue = 0;
+        return queue;
+    }
+
+    static const thread_pool*& thread_owner() {
+        static thread_local const thread_pool* owner = nullptr;
+        return owner;
+    }
+
+    unsigned int this_queue() const {
+        return thread_owner() == this ? thread_queue() : 0;
+    }
+
+    bool pop(const unsigned int i, task_type& task, const bool back) {
+        task_queue& queue = *m_queues[i];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty()) return false;
+        if (back) {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+        } else {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+        }
+        --m_queued;
+        return true;
+    }
+
+    bool run_one(const unsigned int queue) {
+        task_type task;
+        bool found = pop(queue,task,true);
+        for (unsigned int i = 1; !found && i < m_queues.size(); ++i) {
+            found = pop((queue + i) % m_queues.size(),task,false);
+        }
+        if (found) task();
+        return found;
+    }
+
+    void worker(const unsigned int queue) {
+        thread_owner() = this;
+        thread_queue() = queue;
+        while (!m_stop) {
+            if (!run_one(queue)) {
+                std::unique_lock<std::mutex> lock(m_sleep_mutex);
+                m_wake.wait(lock,[this]() { return m_stop || m_queued > 0; });
+            }
+        }
+    }
+};
+
+/// the pool used by parallel_for if none is given, created on first use 
+/// with std::thread::hardware_concurrency() threads
+inline thread_pool& default_thread_pool() {
+    static thread_pool pool;
+    return pool;
+}
+
+template <typename Index=std::ptrdiff_t>
+struct parallel_options {
+    /// ranges with at most this many points are not split further
+    Index grainsize;
+    /// the pool to run on, or default_thread_pool() if null
+    thread_pool* pool;
+
+    parallel_options(const Index grainsize=4096, thread_pool* pool=nullptr):
+        grainsize(grainsize),
+        pool(pool)
+    {}
+};
+
+namespace detail {
+
+template <typename Range, typename F>
+struct parallel_for_job {
+    thread_pool& pool;
+    const F& f;
+    std::atomic<std::ptrdiff_t> remaining;
+    std::mutex error_mutex;
+    std::exception_ptr error;
+
+    parallel_for_job(thread_pool& pool, const F& f, const std::ptrdiff_t size):
+        pool(pool),f(f),remaining(size)
+    {}
+
+    // bisect the range, leaving the upper halves for other threads to steal
+    void run(Range range) {
+        while (range.is_divisible()) {
+            Range upper(range,split());
+            pool.push([this,upper]() { run(upper); });
+        }
+        const std::ptrdiff_t size = range.size();
+        try {
+            range.for_each(f);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(error_mutex);
+            if (!error) error = std::current_exception();
+        }
+        remaining -= size;
+    }
+};
+
+}
+
+/// calls f for every point in range, in parallel. As for lattice::for_each, 
+/// f is called as f(index,offset) if it takes two arguments, otherwise as 
+/// f(index). The range is recursively bisected along its longest dimension 
+/// until each piece has at most options.grainsize points, and the pieces 
+/// are executed by the thread pool. The first exception thrown by f is 
+/// rethrown once all the points have been visited
+template <unsigned int D, typename Coord, typename Index, typename F>
+void parallel_for(const lattice_range<D,Coord,Index>& range, F f,
+                  const parallel_options<Index>& options = 
+                                            parallel_options<Index>()) {
+    typedef lattice_range<D,Coord,Index> range_type;
+    thread_pool& pool = options.pool ? *options.pool : default_thread_pool();
+    detail::parallel_for_job<range_type,F> job(pool,f,range.size());
+    job.run(range_type(range.get_min(),range.get_max(),range.get_stride(),
+                       options.grainsize));
+    pool.run_until([&job]() { return job.remaining == 0; });
+    if (job.error) std::rethrow_exception(job.error);
+}
+
+namespace detail {
+
+/// a splittable range over the positions [begin,end) of a lattice_iterator, 
+/// for ranges that are not a whole box with unit steps. Splitting halves 
+/// the number of points
+template <unsigned int D, typename Coord, typename Index>
+class lattice_iterator_range {
+public:
+    typedef lattice_iterator<D,Coord,Index> iterator;
+
+private:
+    iterator m_first;
+    Index m_begin;
+    Index m_end;
+    Index m_grainsize;
+
+public:
+    template <typename End>
+    lattice_iterator_range(const iterator &begin, const End &end, 
+                           const Index grainsize=1):
+        m_first(begin.get_min(),begin.get_max(),begin.get_stride(),
+                begin.get_step()),
+        m_begin(position(begin)),
+        m_end(position(end)),
+        m_grainsize(grainsize)
+    {
+        if (m_end < m_begin) m_end = m_begin;
+    }
+
+    template <typename Split>
+    lattice_iterator_range(lattice_iterator_range &r, Split):
+        m_first(r.m_first),
+        m_begin(r.m_begin + (r.m_end-r.m_begin)/2),
+        m_end(r.m_end),
+        m_grainsize(r.m_grainsize)
+    {
+        r.m_end = m_begin;
+    }
+
+    Index size() const {
+        return m_end - m_begin;
+    }
+
+    bool is_divisible() const {
+        return size() > m_grainsize && size() > 1;
+    }
+
+    template <typename F>
+    void for_each(F f) const {
+        lattice::for_each(m_first + m_begin,m_first + m_end,f);
+    }
+
+private:
+    Index position(const iterator &it) const {
+        return it - m_first;
+    }
+
+    Index position(const bool) const {
+        return iterator() - m_first;
+    }
+};
+
+}
+
+/// parallel_for over [begin,end) of a range of lattice_iterators. The whole 
+/// box with unit steps is split as a lattice_range, anything else (a range 
+/// that starts or ends part way through the box, or a stepped iterator) is 
+/// split into pieces with equal numbers of points
+template <unsigned int D, typename Coord, typename Index, typename End, 
+          typename F>
+void parallel_for(const iterator_range<lattice_iterator<D,Coord,Index>,End>& range, 
+                  F f,
+                  const parallel_options<Index>& options = 
+                                            parallel_options<Index>()) {
+    typedef lattice_iterator<D,Coord,Index> iterator;
+    const iterator& begin = range.begin();
+    if (begin == false) return;
+    bool whole_box = *begin == begin.get_min() && range.end() == false;
+    for (size_t i = 0; i < D; ++i) {
+        if (begin.get_step()[i] != 1) whole_box = false;
+    }
+    if (whole_box) {
+        parallel_for(lattice_range<D,Coord,Index>(begin),f,options);
+        return;
+    }
+    typedef detail::lattice_iterator_range<D,Coord,Index> range_type;
+    thread_pool& pool = options.pool ? *options.pool : default_thread_pool();
+    range_type whole(begin,range.end(),options.grainsize);
+    detail::parallel_for_job<range_type,F> job(pool,f,whole.size());
+    job.run(whole);
+    pool.run_until([&job]() { return job.remaining == 0; });
+    if (job.error) std::rethrow_exception(job.error);
+}
+
+}
+
+#endif
@@ -0,0 +1,551 @@
+/*
+
+Copyright (c) 2005-2016, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Aboria.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+#ifndef PERIODIC_LATTICE_ITERATOR_H_ 
+#define PERIODIC_LATTICE_ITERATOR_H_ 
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <vector>
+#include "lattice_iterator.h"
+#include "for_each.h"
+
+namespace lattice {
+
+namespace detail {
+
+// x wrapped into [min,min+period)
+template <typename Coord>
+Coord wrap_coordinate(const Coord x, const Coord min, const Coord period) {
+    Coord r = (x - min) % period;
+    if (r < 0) r += period;
+    return min + r;
+}
+
+}
+
+/// iterates over the points of the box [min,max) in row-major order, with 
+/// coordinates wrapped periodically into the domain [domain_min,domain_max), 
+/// so *it and size_t(it) are those of the wrapped point. The box can 
+/// extend past the domain on any side (e.g. the ghost layer of a periodic 
+/// domain, or the domain shifted by some vector), and iterating over it 
+/// reads the periodic images directly instead of copying them into a halo. 
+/// The wrap in operator++ is branch-free, a compare and multiply-subtract 
+/// of the period
+template <unsigned int D, typename Coord=int, typename Index=std::ptrdiff_t>
+class periodic_lattice_iterator {
+    typedef periodic_lattice_iterator<D,Coord,Index> iterator;
+    typedef std::array<Coord,D> int_d;
+
+public:
+    typedef typename lattice_iterator<D,Coord,Index>::stride_type stride_type;
+
+private:
+    int_d m_domain_min;
+    int_d m_domain_max;
+    int_d m_period;
+    int_d m_min;
+    int_d m_max;
+    int_d m_size;
+    // unwrapped coordinates, in [m_min,m_max)
+    int_d m_index;
+    // wrapped coordinates, in [m_domain_min,m_domain_max)
+    int_d m_wrapped;
+    int_d m_wrapped_min;
+    stride_type m_stride;
+    // m_stride*m_period, the change in offset for one wrap
+    stride_type m_period_stride;
+    Index m_offset;
+    bool m_valid;
+
+public:
+    typedef const int_d* pointer;
+	typedef std::random_access_iterator_tag iterator_category;
+	typedef std::random_access_iterator_tag iterator_concept;
+    typedef const int_d reference;
+    typedef int_d value_type;
+	typedef Index difference_type;
+
+    periodic_lattice_iterator():
+        m_domain_min(),
+        m_domain_max(),
+        m_period(),
+        m_min(),
+        m_max(),
+        m_size(),
+        m_index(),
+        m_wrapped(),
+        m_wrapped_min(),
+        m_stride(),
+        m_period_stride(),
+        m_offset(0),
+        m_valid(false)
+    {}
+
+    /// iterate over [min,max) in the periodic domain [domain_min,domain_max)
+    periodic_lattice_iterator(const int_d &domain_min, 
+                              const int_d &domain_max,
+                              const int_d &min, 
+                              const int_d &max):
+        periodic_lattice_iterator(domain_min,domain_max,min,max,
+            lattice_iterator<D,Coord,Index>(domain_min,domain_max).get_stride())
+    {}
+
+    /// as above, with offsets calculated using the strides of a larger 
+    /// enclosing array
+    periodic_lattice_iterator(const int_d &domain_min, 
+                              const int_d &domain_max,
+                              const int_d &min, 
+                              const int_d &max,
+                              const stride_type &stride):
+        m_domain_min(domain_min),
+        m_domain_max(domain_max),
+        m_min(min),
+        m_max(max),
+        m_stride(stride),
+        m_valid(true)
+    {
+        for (size_t i = 0; i < D; ++i) {
+            m_period[i] = m_domain_max[i]-m_domain_min[i];
+            assert(m_period[i] > 0);
+            m_size[i] = m_max[i]-m_min[i];
+            if (m_size[i] <= 0) m_valid = false;
+            m_period_stride[i] = m_stride[i]*m_period[i];
+            m_wrapped_min[i] = detail::wrap_coordinate(m_min[i],m_domain_min[i],
+                                                       m_period[i]);
+        }
+        m_index = m_min;
+        m_wrapped = m_wrapped_min;
+        m_offset = collapse(m_wrapped);
+    }
+
+    const int_d& get_domain_min() const { return m_domain_min; }
+    const int_d& get_domain_max() const { return m_domain_max; }
+    const int_d& get_min() const { return m_min; }
+    const int_d& get_max() const { return m_max; }
+    const stride_type& get_stride() const { return m_stride; }
+
+    /// the coordinates before wrapping, in [min,max)
+    const int_d& unwrapped() const { return m_index; }
+
+    explicit operator size_t() const {
+        return m_offset;
+    }
+
+    reference operator *() const {
+        return m_wrapped;
+    }
+
+    pointer operator ->() const {
+        return &m_wrapped;
+    }
+
+    reference operator [](const difference_type n) const {
+        return *(*this + n);
+    }
+
+    iterator& operator++() {
+        increment();
+        return *this;
+    }
+
+    iterator operator++(int) {
+        iterator tmp(*this);
+        operator++();
+        return tmp;
+    }
+
+    iterator& operator--() {
+        decrement();
+        return *this;
+    }
+
+    iterator operator--(int) {
+        iterator tmp(*this);
+        operator--();
+        return tmp;
+    }
+
+    iterator operator+(const difference_type n) const {
+        iterator tmp(*this);
+        tmp.increment(n);
+        return tmp;
+    }
+
+    iterator& operator+=(const difference_type n) {
+        increment(n);
+        return *this;
+    }
+
+    iterator& operator-=(const difference_type n) {
+        increment(-n);
+        return *this;
+    }
+
+    iterator operator-(const difference_type n) const {
+        iterator tmp(*this);
+        tmp.increment(-n);
+        return tmp;
+    }
+
+    difference_type operator-(const iterator& start) const {
+        if (!m_valid) {
+            if (!start.m_valid) return 0;
+            return start.box_size() - start.linear_position();
+        } else if (!start.m_valid) {
+            return linear_position() - box_size();
+        } else {
+            return linear_position() - start.linear_position();
+        }
+    }
+
+    inline bool operator<(const iterator& rhs) const {
+        return *this - rhs < 0;
+    }
+
+    inline bool operator>(const iterator& rhs) const {
+        return rhs < *this;
+    }
+
+    inline bool operator<=(const iterator& rhs) const {
+        return !(rhs < *this);
+    }
+
+    inline bool operator>=(const iterator& rhs) const {
+        return !(*this < rhs);
+    }
+
+    inline bool operator==(const iterator& rhs) const {
+        if (!rhs.m_valid) return !m_valid;
+        if (!m_valid) return !rhs.m_valid;
+        return m_index == rhs.m_index;
+    }
+
+    inline bool operator==(const bool rhs) const {
+        return m_valid==rhs;
+    }
+
+    inline bool operator!=(const iterator& rhs) const {
+        return !operator==(rhs);
+    }
+
+    inline bool operator!=(const bool rhs) const {
+        return !operator==(rhs);
+    }
+
+private:
+    Index collapse(const int_d& index) const {
+        Index ret = 0;
+        for (size_t i = 0; i < D; ++i) {
+            ret += m_stride[i]*index[i];
+        }
+        return ret;
+    }
+
+    Index box_size() const {
+        Index ret = 1;
+        for (size_t i = 0; i < D; ++i) {
+            ret *= m_size[i];
+        }
+        return ret;
+    }
+
+    Index linear_position() const {
+        Index position = static_cast<Index>(m_index[0])-m_min[0];
+        for (size_t i = 1; i < D; ++i) {
+            position = position*m_size[i] 
+                        + (static_cast<Index>(m_index[i])-m_min[i]);
+        }
+        return position;
+    }
+
+    void set_linear_position(Index position) {
+        assert(position >= 0);
+        if (position >= box_size()) {
+            m_valid = false;
+            return;
+        }
+        for (int i = D-1; i >= 0; --i) {
+            const Index quotient = position / m_size[i];
+            m_index[i] = m_min[i] 
+                + static_cast<Coord>(position - quotient*m_size[i]);
+            m_wrapped[i] = detail::wrap_coordinate(m_index[i],m_domain_min[i],
+                                                   m_period[i]);
+            position = quotient;
+        }
+        m_offset = collapse(m_wrapped);
+        m_valid = true;
+    }
+
+    void increment() {
+        for (int i = D-1; i >= 0; --i) {
+            ++m_index[i];
+            ++m_wrapped[i];
+            const Coord wrap = m_wrapped[i] == m_domain_max[i];
+            m_wrapped[i] -= wrap*m_period[i];
+            m_offset += m_stride[i] - wrap*m_period_stride[i];
+            if (m_index[i] < m_max[i]) return;
+            if (i == 0) break;
+            m_index[i] = m_min[i];
+            m_offset += m_stride[i]*(m_wrapped_min[i]-m_wrapped[i]);
+            m_wrapped[i] = m_wrapped_min[i];
+        }
+        m_valid = false;
+    }
+
+    void decrement() {
+        // a default constructed end iterator has an empty box
+        assert(m_valid || box_size() > 0);
+        if (!m_valid && box_size() == 0) return;
+        increment(-1);
+    }
+
+    void increment(const Index n) {
+        set_linear_position((m_valid ? linear_position() : box_size()) + n);
+    }
+};
+
+template <unsigned int D, typename Coord, typename Index>
+periodic_lattice_iterator<D,Coord,Index> operator+(
+        const typename periodic_lattice_iterator<D,Coord,Index>::difference_type n, 
+        const periodic_lattice_iterator<D,Coord,Index>& it) {
+    return it + n;
+}
+
+/// the linear offsets of a fixed set of neighbours (displacements) of each 
+/// point in the periodic domain [min,max). For points at least 
+/// get_radius() from the boundary these are the same for every point, and 
+/// are precomputed in get_offsets(). Along a row (the innermost dimension) 
+/// the wrap of the outer coordinates is fixed, so row_offsets() does it 
+/// once per row, and the get_radius() points at each end of the row add a 
+/// precomputed wrap of the inner coordinate (row_end_offsets()). 
+/// Coordinates are wrapped with a compare and multiply instead of a branch 
+/// or a modulo. Only a displacement at least as long as the period along 
+/// its dimension (e.g. in a box narrower than the stencil radius) is first 
+/// reduced with a modulo. All the offsets are relative to the offset of the 
+/// point itself, so in[offset + neighbour_offsets[n]] is neighbour n in 
+/// every case
+template <unsigned int D, typename Coord=int, typename Index=std::ptrdiff_t>
+class periodic_neighbours {
+    typedef std::array<Coord,D> int_d;
+
+public:
+    typedef typename lattice_iterator<D,Coord,Index>::stride_type stride_type;
+    typedef std::array<int,D> displacement_type;
+
+private:
+    int_d m_min;
+    int_d m_max;
+    int_d m_period;
+    stride_type m_stride;
+    std::vector<displacement_type> m_displacements;
+    std::vector<Index> m_offsets;
+    Coord m_radius;
+    // the middle of each row, [m_low,m_high), where the inner coordinate of 
+    // every neighbour is in the domain
+    Coord m_low;
+    Coord m_high;
+    // the change in offset from wrapping the inner coordinate of each 
+    // neighbour, for each point at the ends of a row
+    std::vector<Index> m_end_wrap;
+
+public:
+    periodic_neighbours(const int_d& min, const int_d& max, 
+                        const std::vector<displacement_type>& displacements):
+        periodic_neighbours(min,max,
+                lattice_iterator<D,Coord,Index>(min,max).get_stride(),
+                displacements)
+    {}
+
+    periodic_neighbours(const int_d& min, const int_d& max, 
+                        const stride_type& stride,
+                        const std::vector<displacement_type>& displacements):
+        m_min(min),
+        m_max(max),
+        m_stride(stride),
+        m_displacements(displacements),
+        m_offsets(displacements.size(),0),
+        m_radius(0)
+    {
+        for (size_t i = 0; i < D; ++i) {
+            m_period[i] = m_max[i]-m_min[i];
+            assert(m_period[i] > 0);
+        }
+        for (size_t n = 0; n < m_displacements.size(); ++n) {
+            for (size_t i = 0; i < D; ++i) {
+                const int d = m_displacements[n][i];
+                m_offsets[n] += m_stride[i]*d;
+                if (d > m_radius) m_radius = d;
+                if (-d > m_radius) m_radius = -d;
+            }
+        }
+        m_low = std::min(m_min[D-1]+m_radius,m_max[D-1]);
+        m_high = std::max(m_max[D-1]-m_radius,m_low);
+        for (Coord x = m_min[D-1]; x < m_max[D-1]; ++x) {
+            if (x == m_low) x = m_high;
+            if (x == m_max[D-1]) break;
+            for (size_t n = 0; n < m_displacements.size(); ++n) {
+                const int d = m_displacements[n][D-1];
+                m_end_wrap.push_back(wrapped_step(D-1,x,d) - m_stride[D-1]*d);
+            }
+        }
+    }
+
+    size_t size() const { return m_displacements.size(); }
+    const int_d& get_min() const { return m_min; }
+    const int_d& get_max() const { return m_max; }
+    const stride_type& get_stride() const { return m_stride; }
+    const std::vector<displacement_type>& get_displacements() const { 
+        return m_displacements; 
+    }
+
+    /// the largest displacement along any dimension
+    Coord get_radius() const { return m_radius; }
+
+    /// the neighbour offsets of every point at least get_radius() from 
+    /// the boundary
+    const std::vector<Index>& get_offsets() const { return m_offsets; }
+
+    /// true if index is at least get_radius() from the boundary
+    bool is_interior(const int_d& index) const {
+        for (size_t i = 0; i < D; ++i) {
+            if (index[i] < m_min[i]+m_radius || index[i] >= m_max[i]-m_radius) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /// the linear offset of the point index+displacement wrapped into the 
+    /// domain, relative to that of index (which must be in the domain)
+    Index wrapped_offset(const int_d& index, 
+                         const displacement_type& displacement) const {
+        Index ret = 0;
+        for (size_t i = 0; i < D; ++i) {
+            ret += wrapped_step(i,index[i],displacement[i]);
+        }
+        return ret;
+    }
+
+    /// sets offsets[n] to wrapped_offset() of each neighbour n of index
+    template <typename Offsets>
+    void wrapped_offsets(const int_d& index, Offsets& offsets) const {
+        for (size_t n = 0; n < m_displacements.size(); ++n) {
+            offsets[n] = wrapped_offset(index,m_displacements[n]);
+        }
+    }
+
+    /// sets offsets to the neighbour offsets shared by the points of the 
+    /// row through index that are at least get_radius() from either end of 
+    /// the row, i.e. with only the outer coordinates wrapped
+    template <typename Offsets>
+    void row_offsets(const int_d& index, Offsets& offsets) const {
+        for (size_t n = 0; n < m_displacements.size(); ++n) {
+            const displacement_type& displacement = m_displacements[n];
+            Index offset = m_stride[D-1]*displacement[D-1];
+            for (size_t i = 0; i+1 < D; ++i) {
+                offset += wrapped_step(i,index[i],displacement[i]);
+            }
+            offsets[n] = offset;
+        }
+    }
+
+    /// the inner coordinates [middle_min(),middle_max()) of the points 
+    /// at least get_radius() from either end of each row
+    Coord middle_min() const { return m_low; }
+    Coord middle_max() const { return m_high; }
+
+    /// sets offsets to the neighbour offsets of the point with inner 
+    /// coordinate x in a row with the given row_offsets(), where x is 
+    /// outside [middle_min(),middle_max()). This adds a precomputed wrap 
+    /// for each neighbour, so is cheaper than wrapped_offsets()
+    template <typename Row, typename Offsets>
+    void row_end_offsets(const Row& row, const Coord x, Offsets& offsets) const {
+        const size_t k = x < m_low ? x-m_min[D-1] : (m_low-m_min[D-1])+(x-m_high);
+        const Index* const wrap = m_end_wrap.data() + k*m_displacements.size();
+        for (size_t n = 0; n < m_displacements.size(); ++n) {
+            offsets[n] = row[n] + wrap[n];
+        }
+    }
+
+    /// calls f(index, offset, neighbour_offsets) for every point in the 
+    /// domain in row-major order, where neighbour_offsets points to size() 
+    /// offsets relative to offset
+    template <typename F>
+    void for_each(F f) const {
+        std::vector<Index> row(m_displacements.size());
+        std::vector<Index> wrapped(m_displacements.size());
+        const Index* const row_data = row.data();
+        const Index* const wrapped_data = wrapped.data();
+        const Coord low = m_low;
+        const Coord high = m_high;
+        const Index step = m_stride[D-1];
+        int_d row_max = m_max;
+        row_max[D-1] = m_min[D-1]+1;
+        lattice::for_each(
+            lattice_iterator<D,Coord,Index>(m_min,row_max,m_stride),false,
+            [&](const int_d& row_index, const Index row_offset) {
+                int_d index = row_index;
+                Index offset = row_offset;
+                row_offsets(index,row);
+                for (; index[D-1] < low; ++index[D-1], offset += step) {
+                    row_end_offsets(row,index[D-1],wrapped);
+                    f(index,offset,wrapped_data);
+                }
+                for (; index[D-1] < high; ++index[D-1], offset += step) {
+                    f(index,offset,row_data);
+                }
+                for (; index[D-1] < m_max[D-1]; ++index[D-1], offset += step) {
+                    row_end_offsets(row,index[D-1],wrapped);
+                    f(index,offset,wrapped_data);
+                }
+            });
+    }
+
+private:
+    // the change in offset for displacement d from coordinate x along 
+    // dimension i, wrapped into the domain
+    Index wrapped_step(const size_t i, const Coord x, int d) const {
+        // after the modulo a single wrap is enough
+        if (d >= m_period[i] || -d >= m_period[i]) d %= m_period[i];
+        const Coord y = x + d;
+        const Coord wrap = (y < m_min[i]) - (y >= m_max[i]);
+        return m_stride[i]*(d + wrap*m_period[i]);
+    }
+};
+
+}
+
+#endif
@@ -37,6 +37,8 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <utility>
 #include <iterator>
+#include <type_traits>
+#include "for_each.h"
 
 namespace lattice {
 
@@ -57,6 +59,9 @@ struct iterator_range{
     IteratorType1 &begin() { return m_begin; }
     IteratorType2 &end() { return m_end; }
     size_t size() const { return m_end - m_begin; }
+
+    template <typename F>
+    void for_each(F f) const { lattice::for_each(m_begin,m_end,f); }
 };
 
 template <typename IteratorType1>
@@ -76,7 +81,12 @@ struct iterator_range<IteratorType1,bool> {
     const IteratorType2 &end() const { return m_end; }
     IteratorType1 &begin() { return m_begin; }
     IteratorType2 &end() { return m_end; }
-    size_t size() const { return IteratorType1() - m_begin; }
+    size_t size() const { 
+        return typename std::decay<IteratorType1>::type() - m_begin; 
+    }
+
+    template <typename F>
+    void for_each(F f) const { lattice::for_each(m_begin,m_end,f); }
 };
 
 template <typename IteratorType1, typename IteratorType2>
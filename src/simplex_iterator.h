@@ -0,0 +1,459 @@
+/*
+
+Copyright (c) 2005-2016, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Aboria.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+#ifndef SIMPLEX_ITERATOR_H_ 
+#define SIMPLEX_ITERATOR_H_ 
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include "lattice_iterator.h"
+#include "lattice_range.h"
+#include "for_each.h"
+#include "parallel_for.h"
+
+namespace lattice {
+
+namespace detail {
+
+template <typename Index>
+Index gcd(Index a, Index b) {
+    while (b != 0) {
+        const Index t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// the binomial coefficient m choose r, or 0 if m < r. Each partial product 
+// C(m-r+t,t) is itself a binomial coefficient, so t divides ret*(m-r+t). 
+// Dividing out gcd(ret,t) first leaves t/g dividing m-r+t, so no 
+// intermediate is larger than the result
+template <typename Index>
+Index binomial(const Index m, const Index r) {
+    if (r < 0 || m < r) return 0;
+    Index ret = 1;
+    for (Index t = 1; t <= r; ++t) {
+        const Index g = gcd(ret,t);
+        ret = (ret/g)*((m-r+t)/(t/g));
+    }
+    return ret;
+}
+
+}
+
+/// iterates over the strictly increasing tuples i[0] < i[1] < ... < i[D-1] 
+/// with every i[k] in [0,n), in row-major (lexicographic) order, e.g. the 
+/// unique pairs or triplets of n particles, or the upper triangle of a 
+/// symmetric matrix. This visits n choose D tuples, about a factor D! fewer 
+/// than filtering the lattice_iterator over [0,n)^D. Jumps and distances use 
+/// the combinatorial number system: the position of a tuple is a sum of 
+/// binomial coefficients, so random access is exact integer arithmetic in 
+/// O(D^2 log n) and the iterator can be split across threads (see 
+/// simplex_range). size_t(it) is the linear offset of the tuple using 
+/// stride, by default that of the lattice [0,n)^D. Only the number of tuples 
+/// must fit in Index, offsets wrap around if they do not fit in size_t
+template <unsigned int D, typename Coord=int, typename Index=std::ptrdiff_t>
+class simplex_iterator {
+    typedef simplex_iterator<D,Coord,Index> iterator;
+    typedef std::array<Coord,D> int_d;
+
+public:
+    typedef typename lattice_iterator<D,Coord,Index>::stride_type stride_type;
+
+private:
+    Coord m_n;
+    int_d m_index;
+    stride_type m_stride;
+    size_t m_offset;
+    bool m_valid;
+
+public:
+    typedef const int_d* pointer;
+	typedef std::random_access_iterator_tag iterator_category;
+	typedef std::random_access_iterator_tag iterator_concept;
+    typedef const int_d reference;
+    typedef int_d value_type;
+	typedef Index difference_type;
+
+    simplex_iterator():
+        m_n(0),
+        m_index(),
+        m_stride(),
+        m_offset(0),
+        m_valid(false)
+    {}
+
+    explicit simplex_iterator(const Coord n):
+        simplex_iterator(n,default_stride(n))
+    {}
+
+    simplex_iterator(const Coord n, const stride_type &stride):
+        m_n(n),
+        m_stride(stride)
+    {
+        m_valid = m_n >= static_cast<Coord>(D);
+        for (size_t i = 0; i < D; ++i) {
+            m_index[i] = static_cast<Coord>(i);
+        }
+        m_offset = collapse(m_index);
+    }
+
+    Coord get_n() const { return m_n; }
+    const stride_type& get_stride() const { return m_stride; }
+
+    /// the number of tuples, n choose D
+    Index size() const { 
+        return detail::binomial<Index>(m_n,D); 
+    }
+
+    explicit operator size_t() const {
+        return m_offset;
+    }
+
+    reference operator *() const {
+        return m_index;
+    }
+
+    pointer operator ->() const {
+        return &m_index;
+    }
+
+    reference operator [](const difference_type n) const {
+        return *(*this + n);
+    }
+
+    iterator& operator++() {
+        increment();
+        return *this;
+    }
+
+    iterator operator++(int) {
+        iterator tmp(*this);
+        operator++();
+        return tmp;
+    }
+
+    iterator& operator--() {
+        decrement();
+        return *this;
+    }
+
+    iterator operator--(int) {
+        iterator tmp(*this);
+        operator--();
+        return tmp;
+    }
+
+    iterator operator+(const difference_type n) const {
+        iterator tmp(*this);
+        tmp.increment(n);
+        return tmp;
+    }
+
+    iterator& operator+=(const difference_type n) {
+        increment(n);
+        return *this;
+    }
+
+    iterator& operator-=(const difference_type n) {
+        increment(-n);
+        return *this;
+    }
+
+    iterator operator-(const difference_type n) const {
+        iterator tmp(*this);
+        tmp.increment(-n);
+        return tmp;
+    }
+
+    difference_type operator-(const iterator& start) const {
+        if (!m_valid) {
+            if (!start.m_valid) return 0;
+            return start.size() - start.linear_position();
+        } else if (!start.m_valid) {
+            return linear_position() - size();
+        } else {
+            return linear_position() - start.linear_position();
+        }
+    }
+
+    inline bool operator<(const iterator& rhs) const {
+        return *this - rhs < 0;
+    }
+
+    inline bool operator>(const iterator& rhs) const {
+        return rhs < *this;
+    }
+
+    inline bool operator<=(const iterator& rhs) const {
+        return !(rhs < *this);
+    }
+
+    inline bool operator>=(const iterator& rhs) const {
+        return !(*this < rhs);
+    }
+
+    inline bool operator==(const iterator& rhs) const {
+        if (!rhs.m_valid) return !m_valid;
+        if (!m_valid) return !rhs.m_valid;
+        return m_index == rhs.m_index;
+    }
+
+    inline bool operator==(const bool rhs) const {
+        return m_valid==rhs;
+    }
+
+    inline bool operator!=(const iterator& rhs) const {
+        return !operator==(rhs);
+    }
+
+    inline bool operator!=(const bool rhs) const {
+        return !operator==(rhs);
+    }
+
+private:
+    // the row-major strides of [0,n)^D, computed modulo 2^N like the 
+    // offsets so that large n only wrap the offsets
+    static stride_type default_stride(const Coord n) {
+        stride_type stride;
+        size_t s = 1;
+        for (int i = D-1; i >= 0; --i) {
+            stride[i] = static_cast<Index>(s);
+            s *= static_cast<size_t>(n > 0 ? n : 1);
+        }
+        return stride;
+    }
+
+    size_t collapse(const int_d& index) const {
+        size_t ret = 0;
+        for (size_t i = 0; i < D; ++i) {
+            ret += static_cast<size_t>(m_stride[i])
+                    *static_cast<size_t>(index[i]);
+        }
+        return ret;
+    }
+
+    // the number of tuples before m_index. The tuples with i[k] in 
+    // [i[k-1]+1,x) and the same i[0..k-1] number 
+    // C(n-i[k-1]-1,D-k) - C(n-x,D-k)
+    Index linear_position() const {
+        Index position = 0;
+        Index previous = -1;
+        for (size_t k = 0; k < D; ++k) {
+            const Index r = D-k;
+            position += detail::binomial<Index>(m_n-previous-1,r) 
+                        - detail::binomial<Index>(m_n-m_index[k],r);
+            previous = m_index[k];
+        }
+        return position;
+    }
+
+    void set_linear_position(Index position) {
+        assert(position >= 0);
+        if (position >= size()) {
+            m_valid = false;
+            return;
+        }
+        Index previous = -1;
+        for (size_t k = 0; k < D; ++k) {
+            const Index r = D-k;
+            const Index total = detail::binomial<Index>(m_n-previous-1,r);
+            // the largest x with fewer than position+1 tuples before it
+            Index lo = previous+1;
+            Index hi = m_n-r;
+            while (lo < hi) {
+                const Index x = hi - (hi-lo)/2;
+                if (total - detail::binomial<Index>(m_n-x,r) <= position) {
+                    lo = x;
+                } else {
+                    hi = x-1;
+                }
+            }
+            position -= total - detail::binomial<Index>(m_n-lo,r);
+            m_index[k] = static_cast<Coord>(lo);
+            previous = lo;
+        }
+        m_offset = collapse(m_index);
+        m_valid = true;
+    }
+
+    void increment() {
+        // i[k] can be at most n-D+k
+        if (m_index[D-1]+1 < m_n) {
+            ++m_index[D-1];
+            m_offset += static_cast<size_t>(m_stride[D-1]);
+            return;
+        }
+        for (int k = static_cast<int>(D)-2; k >= 0; --k) {
+            if (m_index[k]+1 < m_n-static_cast<Coord>(D-1-k)) {
+                ++m_index[k];
+                for (size_t j = k+1; j < D; ++j) {
+                    m_index[j] = m_index[j-1]+1;
+                }
+                m_offset = collapse(m_index);
+                return;
+            }
+        }
+        m_valid = false;
+    }
+
+    void decrement() {
+        // a default constructed end iterator has an empty simplex
+        assert(m_valid || size() > 0);
+        if (!m_valid && size() == 0) return;
+        increment(-1);
+    }
+
+    void increment(const Index n) {
+        set_linear_position((m_valid ? linear_position() : size()) + n);
+    }
+};
+
+template <unsigned int D, typename Coord, typename Index>
+simplex_iterator<D,Coord,Index> operator+(
+        const typename simplex_iterator<D,Coord,Index>::difference_type n, 
+        const simplex_iterator<D,Coord,Index>& it) {
+    return it + n;
+}
+
+/// a splittable range over the tuples [begin,end) of a simplex_iterator 
+/// (counted in its order), for parallel_for or tbb::parallel_for. Splitting 
+/// cuts the range in half by count, using the exact random access of the 
+/// iterator, so the pieces have equal numbers of tuples
+template <unsigned int D, typename Coord=int, typename Index=std::ptrdiff_t>
+class simplex_range {
+public:
+    typedef simplex_iterator<D,Coord,Index> iterator;
+    typedef iterator const_iterator;
+    typedef typename iterator::stride_type stride_type;
+
+private:
+    iterator m_first;
+    Index m_begin;
+    Index m_end;
+    Index m_grainsize;
+
+public:
+    explicit simplex_range(const Coord n, const Index grainsize=1):
+        m_first(n),
+        m_begin(0),
+        m_end(m_first.size()),
+        m_grainsize(grainsize)
+    {}
+
+    simplex_range(const Coord n, const stride_type &stride, 
+                  const Index grainsize=1):
+        m_first(n,stride),
+        m_begin(0),
+        m_end(m_first.size()),
+        m_grainsize(grainsize)
+    {}
+
+    /// the tuples from begin up to end, which must come from the same n 
+    /// and stride (end can be the default iterator)
+    simplex_range(const iterator &begin, const iterator &end,
+                  const Index grainsize=1):
+        m_first(begin.get_n(),begin.get_stride()),
+        m_begin(begin - m_first),
+        m_end(end - m_first),
+        m_grainsize(grainsize)
+    {}
+
+    /// splits r in two, r keeps the first half of its tuples and this range 
+    /// takes the second half
+    template <typename Split>
+    simplex_range(simplex_range &r, Split):
+        m_first(r.m_first),
+        m_begin(r.m_begin + (r.m_end-r.m_begin)/2),
+        m_end(r.m_end),
+        m_grainsize(r.m_grainsize)
+    {
+        r.m_end = m_begin;
+    }
+
+    Coord get_n() const { return m_first.get_n(); }
+    const stride_type& get_stride() const { return m_first.get_stride(); }
+    Index grainsize() const { return m_grainsize; }
+
+    iterator begin() const { 
+        return m_first + m_begin;
+    }
+
+    iterator end() const { 
+        return m_first + m_end;
+    }
+
+    Index size() const {
+        return m_end - m_begin;
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+
+    bool is_divisible() const {
+        return size() > m_grainsize && size() > 1;
+    }
+
+    /// calls f for every tuple in the range, as f(index,offset) if it takes 
+    /// two arguments, otherwise as f(index)
+    template <typename F>
+    void for_each(F f) const {
+        iterator it = begin();
+        for (Index n = size(); n > 0; --n, ++it) {
+            detail::call_with_offset(f,*it,static_cast<Index>(size_t(it)),0);
+        }
+    }
+};
+
+/// parallel_for over the increasing tuples of a simplex_range, e.g. the 
+/// unique pairs of a pair interaction, split into pieces with equal numbers 
+/// of tuples
+template <unsigned int D, typename Coord, typename Index, typename F>
+void parallel_for(const simplex_range<D,Coord,Index>& range, F f,
+                  const parallel_options<Index>& options = 
+                                            parallel_options<Index>()) {
+    typedef simplex_range<D,Coord,Index> range_type;
+    thread_pool& pool = options.pool ? *options.pool : default_thread_pool();
+    detail::parallel_for_job<range_type,F> job(pool,f,range.size());
+    job.run(range_type(range.begin(),range.end(),options.grainsize));
+    pool.run_until([&job]() { return job.remaining == 0; });
+    if (job.error) std::rethrow_exception(job.error);
+}
+
+}
+
+#endif
@@ -0,0 +1,362 @@
+/*
+
+Copyright (c) 2005-2016, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Aboria.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+#ifndef STATIC_LATTICE_ITERATOR_H_ 
+#define STATIC_LATTICE_ITERATOR_H_ 
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <iterator>
+#include <limits>
+#include <type_traits>
+
+namespace lattice {
+
+constexpr int dynamic_extent = -1;
+
+namespace detail {
+
+template <unsigned int I, int... E>
+struct nth_extent;
+
+template <int First, int... Rest>
+struct nth_extent<0,First,Rest...>: std::integral_constant<int,First> {};
+
+template <unsigned int I, int First, int... Rest>
+struct nth_extent<I,First,Rest...>: nth_extent<I-1,Rest...> {};
+
+// number of dynamic extents in the first I extents
+template <unsigned int I, int... E>
+struct count_dynamic: std::integral_constant<unsigned int,0> {};
+
+template <unsigned int I, int First, int... Rest>
+struct count_dynamic<I,First,Rest...>: std::integral_constant<unsigned int,
+    I == 0 ? 0 : (First == dynamic_extent ? 1 : 0) 
+                    + count_dynamic<(I > 0 ? I-1 : 0),Rest...>::value> {};
+
+}
+
+/// the shape of a lattice, a mix of compile-time extents and run-time 
+/// extents (given as dynamic_extent), similar to std::extents. The 
+/// run-time extents are passed to the constructor in order, e.g.
+/// extents<dynamic_extent,8,dynamic_extent>(n,m)
+template <int... E>
+class extents {
+public:
+    static constexpr unsigned int rank = sizeof...(E);
+    static constexpr unsigned int rank_dynamic = 
+        detail::count_dynamic<sizeof...(E),E...>::value;
+
+private:
+    std::array<int,rank_dynamic> m_dynamic;
+
+public:
+    // dynamic extents default to zero
+    extents():
+        m_dynamic()
+    {}
+
+    template <typename... Args>
+    explicit extents(const Args... args):
+        m_dynamic{{static_cast<int>(args)...}}
+    {
+        static_assert(sizeof...(Args) == rank_dynamic,
+                      "one argument is needed for every dynamic extent");
+    }
+
+    template <unsigned int I>
+    static constexpr int static_extent() {
+        return detail::nth_extent<I,E...>::value;
+    }
+
+    template <unsigned int I>
+    int extent() const {
+        return static_extent<I>() == dynamic_extent ?
+            m_dynamic[detail::count_dynamic<I,E...>::value] :
+            static_extent<I>();
+    }
+};
+
+template <int... E>
+constexpr unsigned int extents<E...>::rank;
+
+template <int... E>
+constexpr unsigned int extents<E...>::rank_dynamic;
+
+/// iterates over the points of the box [0,extents) in row-major order, like
+/// lattice_iterator. Compile-time extents let the compiler fold the strides
+/// and the carry checks in increment() into constants, and the carry chain is 
+/// unrolled for all dimensions
+template <typename Extents, typename Index=std::ptrdiff_t>
+class static_lattice_iterator {
+    typedef static_lattice_iterator<Extents,Index> iterator;
+    static constexpr unsigned int D = Extents::rank;
+    typedef std::array<int,D> int_d;
+    template <unsigned int I>
+    using dim = std::integral_constant<unsigned int,I>;
+
+    Extents m_extents;
+    int_d m_index;
+    Index m_offset;
+public:
+    typedef const int_d* pointer;
+	typedef std::random_access_iterator_tag iterator_category;
+	typedef std::random_access_iterator_tag iterator_concept;
+    typedef const int_d reference;
+    typedef int_d value_type;
+	typedef Index difference_type;
+    typedef std::array<Index,D> stride_type;
+
+    static_lattice_iterator():
+        m_extents(),
+        m_offset(0)
+    {
+        m_index.fill(0);
+        m_index[0] = std::numeric_limits<int>::max();
+    }
+
+    // an empty box (any extent zero) starts at the end
+    explicit static_lattice_iterator(const Extents& extents):
+        m_extents(extents),
+        m_offset(0)
+    {
+        m_index.fill(0);
+        if (box_size() <= 0) m_index[0] = m_extents.template extent<0>();
+    }
+
+    stride_type get_stride() const {
+        stride_type stride;
+        stride[D-1] = 1;
+        for (int i = D-2; i >= 0; --i) {
+            stride[i] = stride[i+1]*extent(i+1);
+        }
+        return stride;
+    }
+
+    explicit operator size_t() const {
+        return m_offset;
+    }
+
+    reference operator *() const {
+        return m_index;
+    }
+
+    pointer operator ->() const {
+        return &m_index;
+    }
+
+    reference operator [](const difference_type n) const {
+        return *(*this + n);
+    }
+
+    iterator& operator++() {
+        increment();
+        return *this;
+    }
+
+    iterator operator++(int) {
+        iterator tmp(*this);
+        operator++();
+        return tmp;
+    }
+
+    iterator& operator--() {
+        increment(Index(-1));
+        return *this;
+    }
+
+    iterator operator--(int) {
+        iterator tmp(*this);
+        operator--();
+        return tmp;
+    }
+
+    iterator operator+(const difference_type n) const {
+        iterator tmp(*this);
+        tmp.increment(n);
+        return tmp;
+    }
+
+    iterator& operator+=(const difference_type n) {
+        increment(n);
+        return *this;
+    }
+
+    iterator& operator-=(const difference_type n) {
+        increment(-n);
+        return *this;
+    }
+
+    iterator operator-(const difference_type n) const {
+        iterator tmp(*this);
+        tmp.increment(-n);
+        return tmp;
+    }
+
+    difference_type operator-(const iterator& start) const {
+        if (!valid()) {
+            if (!start.valid()) return 0;
+            return start.box_size() - start.m_offset;
+        } else if (!start.valid()) {
+            return m_offset - box_size();
+        } else {
+            return m_offset - start.m_offset;
+        }
+    }
+
+    inline bool operator<(const iterator& rhs) const {
+        return *this - rhs < 0;
+    }
+
+    inline bool operator>(const iterator& rhs) const {
+        return rhs < *this;
+    }
+
+    inline bool operator<=(const iterator& rhs) const {
+        return !(rhs < *this);
+    }
+
+    inline bool operator>=(const iterator& rhs) const {
+        return !(*this < rhs);
+    }
+
+    inline bool operator==(const iterator& rhs) const {
+        if (!rhs.valid()) return !valid();
+        if (!valid()) return !rhs.valid();
+        return m_offset == rhs.m_offset;
+    }
+
+    inline bool operator==(const bool rhs) const {
+        return valid()==rhs;
+    }
+
+    inline bool operator!=(const iterator& rhs) const {
+        return !operator==(rhs);
+    }
+
+    inline bool operator!=(const bool rhs) const {
+        return !operator==(rhs);
+    }
+
+private:
+
+    int extent(const unsigned int i) const {
+        return extent(i,dim<0>());
+    }
+
+    template <unsigned int I>
+    int extent(const unsigned int i, dim<I>) const {
+        return i == I ? m_extents.template extent<I>() : extent(i,dim<I+1>());
+    }
+
+    int extent(const unsigned int, dim<D>) const {
+        return 0;
+    }
+
+    // the iterator is past the end once the carry reaches the first 
+    // dimension, so the check can be hoisted out of the inner dimensions
+    bool valid() const {
+        return m_index[0] < m_extents.template extent<0>();
+    }
+
+    Index box_size() const {
+        return box_size(dim<D-1>());
+    }
+
+    template <unsigned int I>
+    Index box_size(dim<I>) const {
+        return box_size(dim<I-1>())*m_extents.template extent<I>();
+    }
+
+    Index box_size(dim<0>) const {
+        return m_extents.template extent<0>();
+    }
+
+    template <unsigned int I>
+    void carry(dim<I>) {
+        if (++m_index[I] < m_extents.template extent<I>()) return;
+        m_index[I] = 0;
+        carry(dim<I-1>());
+    }
+
+    void carry(dim<0>) {
+        ++m_index[0];
+    }
+
+    template <unsigned int I>
+    void set_index(Index& position, dim<I>) {
+        const int n = m_extents.template extent<I>();
+        const Index quotient = position / n;
+        m_index[I] = static_cast<int>(position - quotient*n);
+        position = quotient;
+        set_index(position, dim<I-1>());
+    }
+
+    void set_index(Index& position, dim<0>) {
+        m_index[0] = static_cast<int>(position);
+    }
+
+    void increment() {
+        ++m_offset;
+        carry(dim<D-1>());
+    }
+
+    void increment(const Index n) {
+        Index position = m_offset + n;
+        assert(position >= 0);
+        m_offset = position;
+        if (position >= box_size()) {
+            m_index.fill(0);
+            m_index[0] = m_extents.template extent<0>();
+            m_offset = box_size();
+            return;
+        }
+        set_index(position, dim<D-1>());
+    }
+};
+
+template <typename Extents, typename Index>
+constexpr unsigned int static_lattice_iterator<Extents,Index>::D;
+
+template <typename Extents, typename Index>
+static_lattice_iterator<Extents,Index> operator+(
+        const typename static_lattice_iterator<Extents,Index>::difference_type n, 
+        const static_lattice_iterator<Extents,Index>& it) {
+    return it + n;
+}
+
+}
+
+#endif
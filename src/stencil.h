@@ -0,0 +1,376 @@
+/*
+
+Copyright (c) 2005-2016, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Aboria.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+#ifndef STENCIL_H_ 
+#define STENCIL_H_ 
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstdlib>
+#include <cstddef>
+#include <ratio>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+#include "for_each.h"
+#include "periodic_lattice_iterator.h"
+
+namespace lattice {
+
+/// one tap of a static_stencil: the coefficient Coeff (a std::ratio) applied 
+/// to the point at the given offset (one per dimension)
+template <typename Coeff, int... Offset>
+struct tap {
+    static constexpr unsigned int dimension = sizeof...(Offset);
+
+    static constexpr double coefficient() {
+        return static_cast<double>(Coeff::num)/Coeff::den;
+    }
+
+    static std::array<int,sizeof...(Offset)> offset() {
+        return std::array<int,sizeof...(Offset)>{{Offset...}};
+    }
+
+    template <typename Index>
+    static Index linear_offset(const std::array<Index,sizeof...(Offset)>& stride) {
+        const std::array<int,sizeof...(Offset)> o = offset();
+        Index ret = 0;
+        for (size_t i = 0; i < sizeof...(Offset); ++i) {
+            ret += stride[i]*o[i];
+        }
+        return ret;
+    }
+};
+
+namespace detail {
+
+// the sum of the taps from I onwards, unrolled at compile time
+template <size_t I, typename... Taps>
+struct tap_sum {
+    template <typename T, typename Offsets>
+    static inline T apply(const T*, const Offsets&) {
+        return T(0);
+    }
+};
+
+template <size_t I, typename Tap, typename... Taps>
+struct tap_sum<I,Tap,Taps...> {
+    template <typename T, typename Offsets>
+    static inline T apply(const T* in, const Offsets& offsets) {
+        return static_cast<T>(Tap::coefficient())*in[offsets[I]] 
+                + tap_sum<I+1,Taps...>::apply(in,offsets);
+    }
+};
+
+template <unsigned int D, typename... Taps>
+struct all_taps_have_dimension {
+    static constexpr bool value = true;
+};
+
+template <unsigned int D, typename Tap, typename... Taps>
+struct all_taps_have_dimension<D,Tap,Taps...> {
+    static constexpr bool value = Tap::dimension == D && 
+                                  all_taps_have_dimension<D,Taps...>::value;
+};
+
+}
+
+/// a D-dimensional stencil with the taps (offsets and coefficients) fixed at 
+/// compile time, like the extents of static_lattice_iterator. The weighted 
+/// sum of the taps is unrolled, with each coefficient a constant, e.g. the 
+/// second order Laplacian in 2D is
+///
+/// static_stencil<2, tap<std::ratio<-4>, 0, 0>, 
+///                   tap<std::ratio<1>,-1, 0>, tap<std::ratio<1>,1,0>,
+///                   tap<std::ratio<1>, 0,-1>, tap<std::ratio<1>,0,1>>
+template <unsigned int D, typename... Taps>
+struct static_stencil {
+    static_assert(detail::all_taps_have_dimension<D,Taps...>::value, 
+                  "every tap needs D offsets");
+
+    static constexpr size_t size() { return sizeof...(Taps); }
+
+    /// the linear offset of each tap for an array with the given strides
+    template <typename Index>
+    static std::array<Index,sizeof...(Taps)> linear_offsets(
+            const std::array<Index,D>& stride) {
+        return std::array<Index,sizeof...(Taps)>{{
+            Taps::template linear_offset<Index>(stride)...}};
+    }
+
+    /// the offset of each tap from the centre
+    static std::array<std::array<int,D>,sizeof...(Taps)> offsets() {
+        return std::array<std::array<int,D>,sizeof...(Taps)>{{
+            Taps::offset()...}};
+    }
+
+    /// the largest distance of a tap from the centre along dimension d
+    static int radius(const size_t d) {
+        const std::array<std::array<int,D>,sizeof...(Taps)> offsets = 
+            static_stencil::offsets();
+        int ret = 0;
+        for (size_t i = 0; i < offsets.size(); ++i) {
+            ret = std::max(ret,std::abs(offsets[i][d]));
+        }
+        return ret;
+    }
+
+    /// the weighted sum of the taps around in[0], where offsets are given by 
+    /// linear_offsets()
+    template <typename T, typename Index>
+    static inline T apply(const T* in, 
+                          const std::array<Index,sizeof...(Taps)>& offsets) {
+        return detail::tap_sum<0,Taps...>::apply(in,offsets);
+    }
+};
+
+namespace detail {
+
+// the coefficients of the central difference approximation of the second 
+// derivative, c_k for offsets +-k
+template <int Order, int K>
+struct second_difference;
+
+template <> struct second_difference<2,0> { typedef std::ratio<-2> type; };
+template <> struct second_difference<2,1> { typedef std::ratio<1> type; };
+template <> struct second_difference<4,0> { typedef std::ratio<-5,2> type; };
+template <> struct second_difference<4,1> { typedef std::ratio<4,3> type; };
+template <> struct second_difference<4,2> { typedef std::ratio<-1,12> type; };
+template <> struct second_difference<6,0> { typedef std::ratio<-49,18> type; };
+template <> struct second_difference<6,1> { typedef std::ratio<3,2> type; };
+template <> struct second_difference<6,2> { typedef std::ratio<-3,20> type; };
+template <> struct second_difference<6,3> { typedef std::ratio<1,90> type; };
+
+// tap<Coeff,...> with offset K in dimension Dim and zero elsewhere
+template <typename Coeff, unsigned int N, unsigned int Dim, int K, int... Offset>
+struct axis_tap {
+    typedef typename axis_tap<Coeff,N-1,Dim,K,
+                              (N-1 == Dim ? K : 0),Offset...>::type type;
+};
+
+template <typename Coeff, unsigned int Dim, int K, int... Offset>
+struct axis_tap<Coeff,0,Dim,K,Offset...> {
+    typedef tap<Coeff,Offset...> type;
+};
+
+template <typename A, typename B>
+struct concat_stencil;
+
+template <unsigned int D, typename... A, typename... B>
+struct concat_stencil<static_stencil<D,A...>,static_stencil<D,B...>> {
+    typedef static_stencil<D,A...,B...> type;
+};
+
+// the off-centre taps of the Laplacian for dimensions from Dim and 
+// offsets from K
+template <unsigned int D, int Order, unsigned int Dim=0, int K=1, 
+          bool Done = (Dim == D)>
+struct laplacian_taps {
+    typedef typename second_difference<Order,K>::type coeff;
+    typedef static_stencil<D,
+                typename axis_tap<coeff,D,Dim,-K>::type,
+                typename axis_tap<coeff,D,Dim,K>::type> these;
+    typedef typename laplacian_taps<D,Order,
+                (K == Order/2 ? Dim+1 : Dim),
+                (K == Order/2 ? 1 : K+1)>::type rest;
+    typedef typename concat_stencil<these,rest>::type type;
+};
+
+template <unsigned int D, int Order, unsigned int Dim, int K>
+struct laplacian_taps<D,Order,Dim,K,true> {
+    typedef static_stencil<D> type;
+};
+
+}
+
+/// the central difference Laplacian of order 2, 4 or 6 in D dimensions 
+/// (for unit grid spacing), as a static_stencil with 1+D*Order taps
+template <unsigned int D, int Order>
+struct laplacian_stencil {
+    typedef typename detail::concat_stencil<
+        static_stencil<D,typename detail::axis_tap<
+            std::ratio_multiply<std::ratio<D>,
+                typename detail::second_difference<Order,0>::type>,
+            D,0,0>::type>,
+        typename detail::laplacian_taps<D,Order>::type>::type type;
+};
+
+namespace detail {
+
+// out[i] = alpha*S(in)[i] + beta*in[i] for i in [begin,end), a plain loop 
+// over contiguous memory that the compiler can vectorize
+template <typename Stencil, typename T, typename Index>
+inline void apply_stencil_row(const T* in, T* out, 
+                              const std::array<Index,Stencil::size()>& offsets,
+                              const Index begin, const Index end,
+                              const T alpha, const T beta) {
+    // local copies, so the compiler knows the stores to out can't change 
+    // them
+    const std::array<Index,Stencil::size()> o = offsets;
+    const T a = alpha;
+    const T b = beta;
+    for (Index i = begin; i < end; ++i) {
+        out[i] = a*Stencil::apply(in + i,o) + b*in[i];
+    }
+}
+
+// true if range visits every point of the box of range.begin() once, as 
+// the loops over [get_min(),get_max()) below assume. Ranges that start part 
+// way through their box, end early or step over points do not
+template <typename Range>
+bool covers_box(const Range& range) {
+    const auto& begin = range.begin();
+    const auto& min = begin.get_min();
+    const auto& max = begin.get_max();
+    std::size_t size = 1;
+    for (size_t i = 0; i < min.size(); ++i) {
+        if (max[i] <= min[i]) return true;
+        size *= max[i]-min[i];
+    }
+    return std::size_t(range.size()) == size && *begin == min;
+}
+
+// out = alpha*S(in) + beta*in over the box [min,max), where in and out 
+// point to the point zero of arrays with the given strides. The innermost 
+// dimension is a plain loop over contiguous memory that the compiler can 
+// vectorize
+template <typename Stencil, typename T, typename Coord, std::size_t D, 
+          typename Index>
+void apply_stencil_box(const T* in, T* out, 
+                       const std::array<Index,Stencil::size()>& offsets,
+                       std::array<Coord,D> min, std::array<Coord,D> max,
+                       const std::array<Index,D>& stride,
+                       const T alpha, const T beta) {
+    assert(stride[D-1] == 1);
+    for (size_t i = 0; i < D; ++i) {
+        if (max[i] <= min[i]) return;
+    }
+    // loop over the rows of the box, and along each row
+    const Index n = max[D-1]-min[D-1];
+    max[D-1] = min[D-1]+1;
+    lattice::for_each(min,max,stride,
+        [&](const std::array<Coord,D>&, const Index row) {
+            apply_stencil_row<Stencil>(in + row,out + row,offsets,Index(0),n,
+                                       alpha,beta);
+        });
+}
+
+}
+
+/// sets dst = alpha*S(src) + beta*src at every point of range, where S is 
+/// the static_stencil Stencil. src and dst are grids with the same strides 
+/// (e.g. two halo_grids), and the stencil must stay within src. The linear 
+/// offsets of the taps are calculated once, and the innermost dimension is 
+/// a plain loop over contiguous memory that the compiler can vectorize. The 
+/// loops run over the box of range.begin(), so range must cover its whole 
+/// box (e.g. a halo_grid range or a lattice_range, split or not) rather 
+/// than start or end part way through it
+template <typename Stencil, typename Grid, typename Range>
+void apply_stencil(const Grid& src, Grid& dst, const Range& range,
+                   const typename Grid::value_type alpha=1, 
+                   const typename Grid::value_type beta=0) {
+    assert(detail::covers_box(range));
+    const auto& stride = src.get_stride();
+    assert(stride == dst.get_stride());
+    detail::apply_stencil_box<Stencil>(
+            src.data() - src.get_mapping().get_origin(),
+            dst.data() - dst.get_mapping().get_origin(),
+            Stencil::linear_offsets(stride),
+            range.begin().get_min(),range.begin().get_max(),stride,
+            alpha,beta);
+}
+
+/// as apply_stencil, but with periodic boundaries on the box of range: taps 
+/// that fall outside it wrap around to the other side, so no halo copies are 
+/// needed. The wrap of the outer coordinates is worked out once per row 
+/// (see periodic_neighbours), so the middle of every row is the same 
+/// vectorized loop as apply_stencil, and only the stencil radius points 
+/// at each end of a row wrap their offsets point by point. The box can be 
+/// narrower than the stencil, in which case taps wrap more than once. As 
+/// for apply_stencil, range must cover its whole box
+template <typename Stencil, typename Grid, typename Range>
+void apply_stencil_periodic(const Grid& src, Grid& dst, const Range& range,
+                            const typename Grid::value_type alpha=1, 
+                            const typename Grid::value_type beta=0) {
+    typedef typename Grid::value_type T;
+    typedef typename std::decay<decltype(range.begin().get_min())>::type int_d;
+    typedef typename std::decay<decltype(src.get_stride())>::type stride_type;
+    typedef typename int_d::value_type Coord;
+    typedef typename stride_type::value_type Index;
+    const unsigned int D = std::tuple_size<int_d>::value;
+
+    assert(detail::covers_box(range));
+    const stride_type& stride = src.get_stride();
+    assert(stride == dst.get_stride());
+    assert(stride[D-1] == 1);
+    const T* in = src.data() - src.get_mapping().get_origin();
+    T* out = dst.data() - dst.get_mapping().get_origin();
+    const int_d min = range.begin().get_min();
+    const int_d max = range.begin().get_max();
+    for (size_t i = 0; i < D; ++i) {
+        if (max[i] <= min[i]) return;
+    }
+    const auto taps = Stencil::offsets();
+    const periodic_neighbours<D,Coord,Index> neighbours(min,max,stride,
+            std::vector<std::array<int,D>>(taps.begin(),taps.end()));
+
+    const Coord low = neighbours.middle_min();
+    const Coord high = neighbours.middle_max();
+    int_d row_max = max;
+    row_max[D-1] = min[D-1]+1;
+    lattice::for_each(lattice_iterator<D,Coord,Index>(min,row_max,stride),false,
+        [&](const int_d& row_index, const Index row) {
+            std::array<Index,Stencil::size()> row_offsets, offsets;
+            neighbours.row_offsets(row_index,row_offsets);
+            const T* row_in = in + row - min[D-1];
+            T* row_out = out + row - min[D-1];
+            auto ends = [&](const Coord begin, const Coord end) {
+                for (Coord x = begin; x < end; ++x) {
+                    neighbours.row_end_offsets(row_offsets,x,offsets);
+                    row_out[x] = alpha*Stencil::apply(row_in + x,offsets) 
+                                    + beta*row_in[x];
+                }
+            };
+            ends(min[D-1],low);
+            detail::apply_stencil_row<Stencil>(row_in,row_out,row_offsets,
+                                               Index(low),Index(high),
+                                               alpha,beta);
+            ends(high,max[D-1]);
+        });
+}
+
+}
+
+#endif
@@ -0,0 +1,101 @@
+/*
+
+Copyright (c) 2005-2016, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Aboria.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+#ifndef TEMPORAL_BLOCKING_H_ 
+#define TEMPORAL_BLOCKING_H_ 
+
+#include <algorithm>
+#include <cassert>
+#include <utility>
+#include "stencil.h"
+
+namespace lattice {
+
+/// advances u0 by steps time steps of u <- alpha*S(u) + beta*u over the box 
+/// of range, where S is the static_stencil Stencil, using u1 as the second 
+/// buffer. The result is left in u0. Points outside range (e.g. the halo of 
+/// a halo_grid) are read but never written, so they must hold the same 
+/// boundary values in both grids. As for apply_stencil, range must cover its 
+/// whole box.
+///
+/// Instead of sweeping the whole box once per step, the box is cut into 
+/// blocks of block_width along the outermost dimension, and each block is 
+/// advanced through all the steps before moving on to the next one. The 
+/// block is skewed back by the stencil radius at each step (time skewing), 
+/// which keeps every dependency either inside the block or in a block that 
+/// has already been done, so two buffers are enough. A block only touches 
+/// about block_width + 2*radius*steps slabs of the outermost dimension, so 
+/// if these fit in cache each point is loaded from memory once per call 
+/// rather than once per step
+template <typename Stencil, typename Grid, typename Range>
+void advance_stencil(Grid& u0, Grid& u1, const Range& range, const int steps,
+                     const typename Grid::value_type alpha=1, 
+                     const typename Grid::value_type beta=0,
+                     const int block_width=8) {
+    typedef typename Grid::value_type T;
+    assert(block_width > 0);
+    assert(detail::covers_box(range));
+    if (steps <= 0) return;
+    const auto& stride = u0.get_stride();
+    assert(stride == u1.get_stride());
+    const auto offsets = Stencil::linear_offsets(stride);
+    T* buffer[2] = {u0.data() - u0.get_mapping().get_origin(),
+                    u1.data() - u1.get_mapping().get_origin()};
+    const auto min = range.begin().get_min();
+    const auto max = range.begin().get_max();
+    const int radius = Stencil::radius(0);
+
+    // the blocks cover [min[0],max[0] + radius*(steps-1)) so that, after 
+    // skewing, every step covers the whole box
+    const int extent = max[0]-min[0] + radius*(steps-1);
+    for (int start = 0; start < extent; start += block_width) {
+        for (int step = 0; step < steps; ++step) {
+            auto block_min = min;
+            auto block_max = max;
+            block_min[0] = std::max(min[0],min[0] + start - radius*step);
+            block_max[0] = std::min(max[0],
+                                    min[0] + start + block_width - radius*step);
+            detail::apply_stencil_box<Stencil>(
+                    buffer[step % 2],buffer[(step+1) % 2],offsets,
+                    block_min,block_max,stride,alpha,beta);
+        }
+    }
+    if (steps % 2 == 1) {
+        std::swap(u0,u1);
+    }
+}
+
+}
+
+#endif
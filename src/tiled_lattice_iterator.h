@@ -0,0 +1,384 @@
+/*
+
+Copyright (c) 2005-2016, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Aboria.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+#ifndef TILED_LATTICE_ITERATOR_H_ 
+#define TILED_LATTICE_ITERATOR_H_ 
+
+#include <cassert>
+#include "lattice_iterator.h"
+#include "for_each.h"
+
+namespace lattice {
+
+/// iterates over the box [min,max) one tile at a time, visiting the tiles in 
+/// row-major order and the points within each tile in row-major order. Tiles 
+/// at the upper edges of the box are clipped to the box. Dereferencing gives 
+/// the global index of each point, and the linear offset is calculated using 
+/// the strides of the box (or the strides given in the constructor), so 
+/// loops written for lattice_iterator work unchanged but with better cache 
+/// reuse between neighbouring rows
+template <unsigned int D, typename Coord=int, typename Index=std::ptrdiff_t>
+class tiled_lattice_iterator {
+    typedef tiled_lattice_iterator<D,Coord,Index> iterator;
+    typedef lattice_iterator<D,Coord,Index> tile_iterator;
+    typedef std::array<Coord,D> int_d;
+
+public:
+    typedef typename tile_iterator::stride_type stride_type;
+
+private:
+    int_d m_min;
+    int_d m_max;
+    int_d m_tile;
+    int_d m_tile_index;
+    stride_type m_stride;
+    // number of points in the box in the dimensions after d
+    stride_type m_box_stride;
+    tile_iterator m_inner;
+    bool m_valid;
+
+public:
+    typedef const int_d* pointer;
+	typedef std::random_access_iterator_tag iterator_category;
+	typedef std::random_access_iterator_tag iterator_concept;
+    typedef const int_d reference;
+    typedef int_d value_type;
+	typedef Index difference_type;
+
+    tiled_lattice_iterator():
+        m_min(),
+        m_max(),
+        m_tile_index(),
+        m_stride(),
+        m_box_stride(),
+        m_inner(),
+        m_valid(false)
+    {
+        m_tile.fill(1);
+    }
+
+    tiled_lattice_iterator(const int_d &min, 
+                           const int_d &max,
+                           const int_d &tile):
+        m_min(min),
+        m_max(max),
+        m_tile(tile),
+        m_stride(tile_iterator(min,max).get_stride())
+    {
+        init();
+    }
+
+    tiled_lattice_iterator(const int_d &min, 
+                           const int_d &max,
+                           const int_d &tile,
+                           const stride_type &stride):
+        m_min(min),
+        m_max(max),
+        m_tile(tile),
+        m_stride(stride)
+    {
+        init();
+    }
+
+    const int_d& get_min() const { return m_min; }
+    const int_d& get_max() const { return m_max; }
+    const int_d& get_tile() const { return m_tile; }
+    const stride_type& get_stride() const { return m_stride; }
+
+    explicit operator size_t() const {
+        return size_t(m_inner);
+    }
+
+    reference operator *() const {
+        return *m_inner;
+    }
+
+    pointer operator ->() const {
+        return m_inner.operator->();
+    }
+
+    reference operator [](const difference_type n) const {
+        return *(*this + n);
+    }
+
+    iterator& operator++() {
+        increment();
+        return *this;
+    }
+
+    iterator operator++(int) {
+        iterator tmp(*this);
+        operator++();
+        return tmp;
+    }
+
+    iterator& operator--() {
+        decrement();
+        return *this;
+    }
+
+    iterator operator--(int) {
+        iterator tmp(*this);
+        operator--();
+        return tmp;
+    }
+
+    iterator operator+(const difference_type n) const {
+        iterator tmp(*this);
+        tmp.increment(n);
+        return tmp;
+    }
+
+    iterator& operator+=(const difference_type n) {
+        increment(n);
+        return *this;
+    }
+
+    iterator& operator-=(const difference_type n) {
+        increment(-n);
+        return *this;
+    }
+
+    iterator operator-(const difference_type n) const {
+        iterator tmp(*this);
+        tmp.increment(-n);
+        return tmp;
+    }
+
+    difference_type operator-(const iterator& start) const {
+        if (!m_valid) {
+            if (!start.m_valid) return 0;
+            return start.box_size() - start.linear_position();
+        } else if (!start.m_valid) {
+            return linear_position() - box_size();
+        } else {
+            return linear_position() - start.linear_position();
+        }
+    }
+
+    inline bool operator<(const iterator& rhs) const {
+        return *this - rhs < 0;
+    }
+
+    inline bool operator>(const iterator& rhs) const {
+        return rhs < *this;
+    }
+
+    inline bool operator<=(const iterator& rhs) const {
+        return !(rhs < *this);
+    }
+
+    inline bool operator>=(const iterator& rhs) const {
+        return !(*this < rhs);
+    }
+
+    inline bool operator==(const iterator& rhs) const {
+        if (!rhs.m_valid) return !m_valid;
+        if (!m_valid) return !rhs.m_valid;
+        return *m_inner == *rhs.m_inner;
+    }
+
+    inline bool operator==(const bool rhs) const {
+        return m_valid==rhs;
+    }
+
+    inline bool operator!=(const iterator& rhs) const {
+        return !operator==(rhs);
+    }
+
+    inline bool operator!=(const bool rhs) const {
+        return !operator==(rhs);
+    }
+
+    template <unsigned int D2, typename Coord2, typename Index2, 
+              typename End, typename F>
+    friend void for_each(tiled_lattice_iterator<D2,Coord2,Index2> begin, 
+                         const End& end, F f);
+
+private:
+    // the box of the current tile
+    int_d tile_min() const {
+        int_d ret;
+        for (size_t i = 0; i < D; ++i) {
+            ret[i] = m_min[i] + m_tile_index[i]*m_tile[i];
+        }
+        return ret;
+    }
+
+    // moves to the first point of the next tile
+    void next_tile() {
+        for (int i=D-1; i>=0; --i) {
+            ++m_tile_index[i];
+            if (m_tile_index[i] < tile_count(i)) break;
+            if (i != 0) {
+                m_tile_index[i] = 0;
+            } else {
+                m_valid = false;
+                return;
+            }
+        }
+        m_inner = tile_iterator(tile_min(),tile_max(),m_stride);
+    }
+
+    int_d tile_max() const {
+        int_d ret;
+        for (size_t i = 0; i < D; ++i) {
+            ret[i] = m_min[i] + m_tile_index[i]*m_tile[i] 
+                        + tile_width(i,m_tile_index[i]);
+        }
+        return ret;
+    }
+
+    void init() {
+        for (size_t i = 0; i < D; ++i) {
+            assert(m_tile[i] > 0);
+        }
+        m_box_stride[D-1] = 1;
+        for (int i = D-2; i >= 0; --i) {
+            m_box_stride[i] = m_box_stride[i+1]*(m_max[i+1]-m_min[i+1]);
+        }
+        m_valid = box_size() > 0;
+        m_tile_index.fill(0);
+        if (m_valid) {
+            m_inner = tile_iterator(tile_min(),tile_max(),m_stride);
+        }
+    }
+
+    Coord tile_width(const size_t d, const Coord tile_index) const {
+        const Coord remaining = m_max[d]-m_min[d] - tile_index*m_tile[d];
+        return remaining < m_tile[d] ? remaining : m_tile[d];
+    }
+
+    Coord tile_count(const size_t d) const {
+        return (m_max[d]-m_min[d] + m_tile[d] - 1)/m_tile[d];
+    }
+
+    Index box_size() const {
+        Index count = 1;
+        for (size_t i = 0; i < D; ++i) {
+            if (m_max[i] <= m_min[i]) return 0;
+            count *= m_max[i]-m_min[i];
+        }
+        return count;
+    }
+
+    // the tiles before the current one along dimension d are all full, 
+    // so the number of points visited before the current tile is a sum of 
+    // D slabs
+    Index linear_position() const {
+        Index position = 0;
+        Index width_before = 1;
+        for (size_t d = 0; d < D; ++d) {
+            position += width_before*m_tile_index[d]*m_tile[d]*m_box_stride[d];
+            width_before *= tile_width(d,m_tile_index[d]);
+        }
+        return position + (m_inner - tile_iterator(tile_min(),tile_max(),
+                                                   m_stride));
+    }
+
+    void set_linear_position(Index position) {
+        assert(position >= 0);
+        if (position >= box_size()) {
+            m_valid = false;
+            return;
+        }
+        Index width_before = 1;
+        for (size_t d = 0; d < D; ++d) {
+            const Index slab = width_before*m_tile[d]*m_box_stride[d];
+            m_tile_index[d] = static_cast<Coord>(position/slab);
+            position -= m_tile_index[d]*slab;
+            width_before *= tile_width(d,m_tile_index[d]);
+        }
+        m_inner = tile_iterator(tile_min(),tile_max(),m_stride) + position;
+        m_valid = true;
+    }
+
+    void increment() {
+        ++m_inner;
+        if (m_inner == false) next_tile();
+    }
+
+    void decrement() {
+        // a default constructed end iterator has an empty box
+        assert(m_valid || box_size() > 0);
+        if (!m_valid && box_size() == 0) return;
+        increment(-1);
+    }
+
+    void increment(const Index n) {
+        set_linear_position((m_valid ? linear_position() : box_size()) + n);
+    }
+};
+
+template <unsigned int D, typename Coord, typename Index>
+tiled_lattice_iterator<D,Coord,Index> operator+(
+        const typename tiled_lattice_iterator<D,Coord,Index>::difference_type n, 
+        const tiled_lattice_iterator<D,Coord,Index>& it) {
+    return it + n;
+}
+
+/// calls f for every point in [begin,end), lowering each whole tile to 
+/// nested for loops (see lattice::for_each)
+template <unsigned int D, typename Coord, typename Index, typename End, 
+          typename F>
+void for_each(tiled_lattice_iterator<D,Coord,Index> begin, const End& end, 
+              F f) {
+    if (begin == false) return;
+    Index remaining = detail::distance_to(begin,end);
+    // finish the first tile point by point if begin is part way through it
+    const auto first_tile = begin.tile_min();
+    for (; remaining > 0 && *begin != first_tile 
+           && begin.tile_min() == first_tile; --remaining, ++begin) {
+        detail::call_with_offset(f,*begin,static_cast<Index>(size_t(begin)),0);
+    }
+    for (; remaining > 0; begin.next_tile()) {
+        const auto min = begin.tile_min();
+        const auto max = begin.tile_max();
+        Index tile_size = 1;
+        for (size_t i = 0; i < D; ++i) {
+            tile_size *= max[i]-min[i];
+        }
+        if (tile_size > remaining) break;
+        lattice::for_each(min,max,begin.get_stride(),f);
+        remaining -= tile_size;
+    }
+    // and the last tile if end is part way through it
+    for (; remaining > 0; --remaining, ++begin) {
+        detail::call_with_offset(f,*begin,static_cast<Index>(size_t(begin)),0);
+    }
+}
+
+}
+
+#endif
@@ -0,0 +1,1221 @@
+
+#define CATCH_CONFIG_MAIN  // This tells Catch to provide a main() - only do this in one cpp file
+#include "catch.hpp"
+#include "lattice.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <vector>
+#include <functional>
+#include <iostream>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+using namespace lattice;
+
+// counts a hardware event for the calling thread using perf_event_open. 
+// count() returns -1 if the counter is not available (e.g. not linux, 
+// perf_event_paranoid too high, or no PMU access in a virtual machine)
+class perf_counter {
+    int m_fd;
+public:
+    perf_counter(const unsigned int type, const unsigned long long config):
+        m_fd(-1) {
+#ifdef __linux__
+        perf_event_attr attr;
+        std::memset(&attr,0,sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        m_fd = syscall(__NR_perf_event_open,&attr,0,-1,-1,0);
+#endif
+    }
+
+    ~perf_counter() {
+#ifdef __linux__
+        if (m_fd >= 0) close(m_fd);
+#endif
+    }
+
+    void start() {
+#ifdef __linux__
+        if (m_fd < 0) return;
+        ioctl(m_fd,PERF_EVENT_IOC_RESET,0);
+        ioctl(m_fd,PERF_EVENT_IOC_ENABLE,0);
+#endif
+    }
+
+    long long count() {
+        long long value = -1;
+#ifdef __linux__
+        if (m_fd < 0) return -1;
+        ioctl(m_fd,PERF_EVENT_IOC_DISABLE,0);
+        if (read(m_fd,&value,sizeof(value)) != sizeof(value)) value = -1;
+#endif
+        return value;
+    }
+};
+
+template <typename F>
+double time_it(F f) {
+    auto t0 = std::chrono::high_resolution_clock::now();
+    f();
+    auto t1 = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double>(t1 - t0).count();
+}
+
+// the floating point random access used by lattice_iterator before the 
+// integer jump engine was added
+template <unsigned int D>
+std::array<int,D> float_jump(const std::array<int,D>& min, 
+                             const std::array<int,D>& max,
+                             const std::array<int,D>& index,
+                             const int n) {
+    std::array<int,D> size;
+    for (size_t i = 0; i < D; ++i) size[i] = max[i]-min[i];
+    int collapsed = 0;
+    unsigned int multiplier = 1.0;
+    for (int i = D-1; i>=0; --i) {
+        if (i != D-1) {
+            multiplier *= size[i+1];
+        }
+        collapsed += multiplier*index[i];
+    }
+    collapsed += n;
+    std::array<int,D> vindex;
+    int i = collapsed;
+    for (int d = D-1; d>=0; --d) {
+        double div = (double)i / size[d];
+        vindex[d] = std::round((div-std::floor(div)) * size[d]);
+        i = std::floor(div);
+    }
+    return vindex;
+}
+
+template <unsigned int D>
+void benchmark_jump(const int total_bits, const size_t njumps) {
+    typedef std::array<int,D> int_d;
+    int_d min,max;
+    for (size_t i = 0; i < D; ++i) {
+        min[i] = 0;
+        // non power of two extents so that the divisions are not shifts
+        max[i] = (1 << (total_bits/D)) - 1;
+    }
+    lattice_iterator<D> begin(min,max);
+    lattice_iterator<D> end;
+    const int total = end - begin;
+
+    std::mt19937 generator;
+    std::uniform_int_distribution<int> uniform(0,total-1);
+    std::vector<int> offsets(njumps);
+    for (auto& n: offsets) n = uniform(generator);
+
+    long sum_float = 0;
+    const double t_float = time_it([&]() {
+        for (const int n: offsets) {
+            sum_float += float_jump<D>(min,max,min,n)[D-1];
+        }
+    });
+
+    long sum_int = 0;
+    const double t_int = time_it([&]() {
+        for (const int n: offsets) {
+            sum_int += (*(begin + n))[D-1];
+        }
+    });
+
+    CHECK(sum_float == sum_int);
+    std::cout << "D = "<<D<<" points = "<<total
+              << " float jump = "<<1e9*t_float/njumps<<" ns"
+              << " integer jump = "<<1e9*t_int/njumps<<" ns"
+              << " speedup = "<<t_float/t_int<<std::endl;
+}
+
+TEST_CASE( "random access jump", "[benchmark][jump]" ) {
+#ifdef LATTICE_FAST_DIVISION
+    std::cout << "integer jump using magic number division"<<std::endl;
+#else
+    std::cout << "integer jump using hardware division"<<std::endl;
+#endif
+    const size_t njumps = 1000000;
+    benchmark_jump<1>(24,njumps);
+    benchmark_jump<2>(24,njumps);
+    benchmark_jump<3>(24,njumps);
+    benchmark_jump<4>(24,njumps);
+    benchmark_jump<5>(24,njumps);
+    benchmark_jump<6>(24,njumps);
+}
+
+// the inner loops below are kept out of line so that their code can be 
+// compared with "make benchmarks.s"
+template <unsigned int D>
+__attribute__((noinline))
+void fill_dynamic(lattice_iterator<D> it, std::vector<int>& values) {
+    for (; it != false; ++it) {
+        values[size_t(it)] = (*it)[0] + (*it)[D-1];
+    }
+}
+
+template <typename Extents>
+__attribute__((noinline))
+void fill_static(static_lattice_iterator<Extents> it, std::vector<int>& values) {
+    const unsigned int D = Extents::rank;
+    for (; it != false; ++it) {
+        values[size_t(it)] = (*it)[0] + (*it)[D-1];
+    }
+}
+
+template <unsigned int D>
+__attribute__((noinline))
+void fill_for_each(const std::array<int,D>& min, const std::array<int,D>& max, 
+                   std::vector<int>& values) {
+    int *const data = values.data();
+    lattice::for_each(min,max,
+        [data](const std::array<int,D>& index, const std::ptrdiff_t offset) {
+            data[offset] = index[0] + index[D-1];
+        });
+}
+
+__attribute__((noinline))
+void fill_loops(const int n, std::vector<int>& values) {
+    for (int i = 0; i < n; ++i) {
+        for (int j = 0; j < n; ++j) {
+            for (int k = 0; k < n; ++k) {
+                values[(i*n + j)*n + k] = i + k;
+            }
+        }
+    }
+}
+
+TEST_CASE( "static extents and for_each", "[benchmark][static][for_each]" ) {
+    const unsigned int D = 3;
+    const int n = 128;
+    const int repeats = 50;
+    typedef std::array<int,D> int_d;
+    typedef extents<n,n,n> static_extents;
+    typedef extents<dynamic_extent,n,n> mixed_extents;
+
+    std::vector<int> values_d(n*n*n), values_s(n*n*n),
+                     values_m(n*n*n), values_l(n*n*n);
+
+    const double t_dynamic = time_it([&]() {
+        for (int i = 0; i < repeats; ++i) {
+            fill_dynamic(lattice_iterator<D>(int_d{{0,0,0}},int_d{{n,n,n}}),
+                         values_d);
+        }
+    });
+    const double t_static = time_it([&]() {
+        for (int i = 0; i < repeats; ++i) {
+            fill_static(static_lattice_iterator<static_extents>(
+                                    static_extents()),values_s);
+        }
+    });
+    const double t_mixed = time_it([&]() {
+        for (int i = 0; i < repeats; ++i) {
+            fill_static(static_lattice_iterator<mixed_extents>(
+                                    mixed_extents(n)),values_m);
+        }
+    });
+    std::vector<int> values_f(n*n*n);
+    const double t_for_each = time_it([&]() {
+        for (int i = 0; i < repeats; ++i) {
+            fill_for_each<D>(int_d{{0,0,0}},int_d{{n,n,n}},values_f);
+        }
+    });
+    const double t_loops = time_it([&]() {
+        for (int i = 0; i < repeats; ++i) {
+            fill_loops(n,values_l);
+        }
+    });
+
+    CHECK( values_d == values_l );
+    CHECK( values_s == values_l );
+    CHECK( values_m == values_l );
+    CHECK( values_f == values_l );
+    const double points = double(repeats)*n*n*n;
+    std::cout << "D = "<<D<<" n = "<<n
+              << " lattice_iterator = "<<1e9*t_dynamic/points<<" ns/point"
+              << " static extents = "<<1e9*t_static/points<<" ns/point"
+              << " mixed extents = "<<1e9*t_mixed/points<<" ns/point"
+              << " for_each = "<<1e9*t_for_each/points<<" ns/point"
+              << " nested loops = "<<1e9*t_loops/points<<" ns/point"
+              <<std::endl;
+}
+
+TEST_CASE( "parallel_for scaling", "[benchmark][parallel]" ) {
+    const unsigned int D = 2;
+    typedef std::array<int,D> int_d;
+    const int n = 1024;
+    const int timesteps = 50;
+    const int_d min = {{0,0}};
+    const int_d max = {{n,n}};
+    const int_d min_domain = {{1,1}};
+    const int_d max_domain = {{n-1,n-1}};
+    const auto stride = lattice_iterator<D>(min,max).get_stride();
+    const lattice_range<D> domain(min_domain,max_domain,stride);
+
+    std::vector<double> serial;
+    double t_serial = 0;
+    const unsigned int max_threads = thread_pool::default_threads();
+    for (unsigned int nthreads = 1; nthreads <= max_threads; ++nthreads) {
+        thread_pool pool(nthreads);
+        std::vector<double> values0(n*n,0.0), values1(n*n,0.0);
+        for (int i = 0; i < n; ++i) values0[i] = values1[i] = 1.0;
+
+        const double t = time_it([&]() {
+            for (int i = 0; i < timesteps; ++i) {
+                const double* u0 = values0.data();
+                double* u1 = values1.data();
+                parallel_for(domain,
+                    [=](const int_d&, const std::ptrdiff_t j) {
+                        u1[j] = u0[j] + 0.2*(u0[j-n] + u0[j+n] 
+                                             + u0[j-1] + u0[j+1] - 4*u0[j]);
+                    }, parallel_options<>(16384,&pool));
+                values0.swap(values1);
+            }
+        });
+
+        if (nthreads == 1) {
+            serial = values0;
+            t_serial = t;
+        } else {
+            CHECK( values0 == serial );
+        }
+        std::cout << "threads = "<<nthreads
+                  << " time per sweep = "<<1e3*t/timesteps<<" ms"
+                  << " speedup = "<<t_serial/t<<std::endl;
+    }
+}
+
+template <typename Iterator>
+__attribute__((noinline))
+void laplace_sweep(Iterator it, const std::array<std::ptrdiff_t,3>& stride,
+                   const std::vector<double>& u0, std::vector<double>& u1) {
+    for (; it != false; ++it) {
+        const size_t j = size_t(it);
+        u1[j] = u0[j] + 0.1*(u0[j-stride[0]] + u0[j+stride[0]] 
+                             + u0[j-stride[1]] + u0[j+stride[1]]
+                             + u0[j-stride[2]] + u0[j+stride[2]] - 6*u0[j]);
+    }
+}
+
+TEST_CASE( "tiled traversal", "[benchmark][tiled]" ) {
+    const unsigned int D = 3;
+    typedef std::array<int,D> int_d;
+    const int n = 256;
+    const int sweeps = 5;
+    const int_d min = {{0,0,0}};
+    const int_d max = {{n,n,n}};
+    const int_d min_domain = {{1,1,1}};
+    const int_d max_domain = {{n-1,n-1,n-1}};
+    const auto stride = lattice_iterator<D>(min,max).get_stride();
+
+    std::vector<double> u0(n*n*n,1.0), u1(n*n*n,0.0);
+    std::vector<double> reference;
+    double t_row_major = 0;
+    for (int i = 0; i < sweeps; ++i) {
+        t_row_major += time_it([&]() {
+            laplace_sweep(lattice_iterator<D>(min_domain,max_domain,stride),
+                          stride,u0,u1);
+        });
+    }
+    reference = u1;
+    std::cout << "D = "<<D<<" n = "<<n<<" row-major = "
+              <<1e3*t_row_major/sweeps<<" ms/sweep"<<std::endl;
+
+    const std::array<int_d,4> tiles = {{{{8,8,n}},{{16,16,n}},
+                                        {{32,32,n}},{{16,16,64}}}};
+    for (const int_d& tile: tiles) {
+        std::fill(u1.begin(),u1.end(),0.0);
+        double t_tiled = 0;
+        for (int i = 0; i < sweeps; ++i) {
+            t_tiled += time_it([&]() {
+                laplace_sweep(tiled_lattice_iterator<D>(min_domain,max_domain,
+                                                        tile,stride),
+                              stride,u0,u1);
+            });
+        }
+        CHECK( u1 == reference );
+        std::cout << "tile = "<<tile[0]<<"x"<<tile[1]<<"x"<<tile[2]
+                  << " tiled = "<<1e3*t_tiled/sweeps<<" ms/sweep"
+                  << " speedup = "<<t_row_major/t_tiled<<std::endl;
+    }
+}
+
+TEST_CASE( "morton traversal", "[benchmark][morton]" ) {
+    const unsigned int D = 3;
+    typedef std::array<int,D> int_d;
+    const int n = 256;
+    const int_d min = {{0,0,0}};
+    const int_d max = {{n,n,n}};
+    const int_d min_domain = {{1,1,1}};
+    const int_d max_domain = {{n-1,n-1,n-1}};
+    const auto stride = lattice_iterator<D>(min,max).get_stride();
+
+#ifdef __BMI2__
+    std::cout << "morton codes using BMI2 pdep/pext"<<std::endl;
+#else
+    std::cout << "morton codes using portable bit twiddling"<<std::endl;
+#endif
+
+    std::vector<double> u0(n*n*n,1.0), u1(n*n*n,0.0);
+    perf_counter llc_misses(PERF_TYPE_HARDWARE,PERF_COUNT_HW_CACHE_MISSES);
+    perf_counter l1_misses(PERF_TYPE_HW_CACHE,
+                           PERF_COUNT_HW_CACHE_L1D 
+                           | (PERF_COUNT_HW_CACHE_OP_READ << 8) 
+                           | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+
+    auto report = [&](const char* name, const std::function<void()>& sweep) {
+        llc_misses.start();
+        l1_misses.start();
+        const double t = time_it(sweep);
+        const long long llc = llc_misses.count();
+        const long long l1 = l1_misses.count();
+        std::cout << name << " = "<<1e3*t<<" ms/sweep"
+                  << " L1D read misses = ";
+        if (l1 < 0) std::cout << "n/a"; else std::cout << l1;
+        std::cout << " LLC misses = ";
+        if (llc < 0) std::cout << "n/a"; else std::cout << llc;
+        std::cout << std::endl;
+    };
+
+    std::cout << "D = "<<D<<" n = "<<n<<std::endl;
+    report("row-major",[&]() {
+        laplace_sweep(lattice_iterator<D>(min_domain,max_domain,stride),
+                      stride,u0,u1);
+    });
+    const std::vector<double> reference = u1;
+    std::fill(u1.begin(),u1.end(),0.0);
+    report("tiled 16x16x256",[&]() {
+        laplace_sweep(tiled_lattice_iterator<D>(min_domain,max_domain,
+                                                int_d{{16,16,n}},stride),
+                      stride,u0,u1);
+    });
+    CHECK( u1 == reference );
+    std::fill(u1.begin(),u1.end(),0.0);
+    report("morton",[&]() {
+        laplace_sweep(morton_lattice_iterator<D>(min_domain,max_domain,stride),
+                      stride,u0,u1);
+    });
+    CHECK( u1 == reference );
+    std::fill(u1.begin(),u1.end(),0.0);
+    report("hilbert",[&]() {
+        laplace_sweep(hilbert_lattice_iterator<D>(min_domain,max_domain,stride),
+                      stride,u0,u1);
+    });
+    CHECK( u1 == reference );
+}
+
+// number of face neighbours of each point that belong to a different chunk 
+// when the traversal of Iterator is cut into equal chunks, i.e. the halo 
+// each thread would have to exchange
+template <typename Iterator>
+long halo_points(const Iterator begin, const int n, const int chunks) {
+    const unsigned int D = 3;
+    std::vector<int> owner(n*n*n);
+    const std::ptrdiff_t total = n*n*n;
+    for (Iterator it = begin; it != false; ++it) {
+        owner[size_t(it)] = chunks*(it - begin)/total;
+    }
+    const auto stride = lattice_iterator<D>(std::array<int,D>{{0,0,0}},
+                                            std::array<int,D>{{n,n,n}})
+                                            .get_stride();
+    long halo = 0;
+    for (lattice_iterator<D> it(std::array<int,D>{{0,0,0}},
+                                std::array<int,D>{{n,n,n}}); it != false; ++it) {
+        for (size_t d = 0; d < D; ++d) {
+            if ((*it)[d] + 1 < n && 
+                owner[size_t(it)] != owner[size_t(it) + stride[d]]) {
+                halo += 2;
+            }
+        }
+    }
+    return halo;
+}
+
+TEST_CASE( "chunk compactness", "[benchmark][hilbert]" ) {
+    const unsigned int D = 3;
+    typedef std::array<int,D> int_d;
+    const int n = 96;
+    const int_d min = {{0,0,0}};
+    const int_d max = {{n,n,n}};
+    for (const int chunks: {4,12,48}) {
+        std::cout << "n = "<<n<<" chunks = "<<chunks
+                  << " halo points: row-major = "
+                  << halo_points(lattice_iterator<D>(min,max),n,chunks)
+                  << " morton = "
+                  << halo_points(morton_lattice_iterator<D>(min,max),n,chunks)
+                  << " hilbert = "
+                  << halo_points(hilbert_lattice_iterator<D>(min,max),n,chunks)
+                  << std::endl;
+    }
+}
+
+// one Jacobi sweep of the Laplacian over the interior of the grids u0 and u1, 
+// which have the same layout
+template <typename Grid>
+void laplace_sweep(const Grid& u0, Grid& u1) {
+    const unsigned int D = 3;
+    typedef std::array<int,D> int_d;
+    const auto& stride = u0.get_stride();
+    const std::ptrdiff_t origin = u0.get_mapping().get_origin();
+    const double* in = u0.data() - origin;
+    double* out = u1.data() - origin;
+    int_d min = u0.get_min(), max = u0.get_max();
+    for (size_t i = 0; i < D; ++i) {
+        ++min[i];
+        --max[i];
+    }
+    lattice::for_each(min,max,stride,
+            [&](const int_d&, const std::ptrdiff_t j) {
+        out[j] = in[j] + 0.1*(in[j-stride[0]] + in[j+stride[0]] 
+                              + in[j-stride[1]] + in[j+stride[1]]
+                              + in[j-stride[2]] + in[j+stride[2]] - 6*in[j]);
+    });
+}
+
+TEST_CASE( "padded rows", "[benchmark][grid]" ) {
+    const unsigned int D = 3;
+    typedef std::array<int,D> int_d;
+    const int sweeps = 5;
+    for (const int n: {128,256}) {
+        const int_d min = {{0,0,0}};
+        const int_d max = {{n,n,n}};
+        grid<double,D> dense0(min,max,1.0), dense1(min,max,0.0);
+        grid<double,D,padded_row_major<8>> padded0(min,max,1.0), 
+                                           padded1(min,max,0.0);
+        double t_dense = 0, t_padded = 0;
+        for (int i = 0; i < sweeps; ++i) {
+            t_dense += time_it([&]() { laplace_sweep(dense0,dense1); });
+            t_padded += time_it([&]() { laplace_sweep(padded0,padded1); });
+        }
+        size_t mismatches = 0;
+        for (lattice_iterator<D> it(min,max); it != false; ++it) {
+            if (dense1[it] != padded1[it]) ++mismatches;
+        }
+        CHECK( mismatches == 0 );
+        std::cout << "D = "<<D<<" n = "<<n
+                  << " pitch = "<<padded0.get_stride()[D-2]
+                  << " dense = "<<1e3*t_dense/sweeps<<" ms/sweep"
+                  << " padded = "<<1e3*t_padded/sweeps<<" ms/sweep"
+                  << " speedup = "<<t_dense/t_padded<<std::endl;
+    }
+}
+
+TEST_CASE( "shell iterator", "[benchmark][shell]" ) {
+    const unsigned int D = 3;
+    typedef std::array<int,D> int_d;
+    for (const int n: {64,256}) {
+        const int_d min = {{0,0,0}};
+        const int_d max = {{n,n,n}};
+        std::vector<double> u(n*n*n,0.0);
+        const double t_shell = time_it([&]() {
+            for (lattice_shell_iterator<D> it(min,max); it != false; ++it) {
+                u[size_t(it)] += 1.0;
+            }
+        });
+        const double t_filter = time_it([&]() {
+            for (lattice_iterator<D> it(min,max); it != false; ++it) {
+                const int_d& i = *it;
+                if (i[0] == 0 || i[0] == n-1 || i[1] == 0 || i[1] == n-1 
+                        || i[2] == 0 || i[2] == n-1) {
+                    u[size_t(it)] += 1.0;
+                }
+            }
+        });
+        CHECK( u[0] == 2.0 );
+        std::cout << "D = "<<D<<" n = "<<n
+                  << " shell = "<<1e3*t_shell<<" ms"
+                  << " box and filter = "<<1e3*t_filter<<" ms"
+                  << " speedup = "<<t_filter/t_shell<<std::endl;
+    }
+}
+
+// the central difference coefficients looked up at run time, as in the 
+// finite difference test
+template <int O>
+double coefficient(const int j) {
+    static const double coeff2[] = {1.0,-2.0,1.0};
+    static const double coeff4[] = {-1.0/12,4.0/3,-5.0/2,4.0/3,-1.0/12};
+    static const double coeff6[] = {1.0/90,-3.0/20,3.0/2,-49.0/18,
+                                    3.0/2,-3.0/20,1.0/90};
+    const double* coeff = O == 2 ? coeff2 : O == 4 ? coeff4 : coeff6;
+    return coeff[j+O/2];
+}
+
+template <int Order>
+void benchmark_stencil(const int n, const int steps) {
+    const unsigned int D = 2;
+    typedef std::array<int,D> int_d;
+    const double r = 0.1;
+    const int_d min = {{0,0}};
+    const int_d max = {{n,n}};
+
+    // the loop of the finite difference test
+    const int_d max_all = {{n+Order,n+Order}};
+    const int_d min_domain = {{Order/2,Order/2}};
+    const int_d max_domain = {{n+Order/2,n+Order/2}};
+    const auto stride = lattice_iterator<D>(min,max_all).get_stride();
+    std::vector<double> values0((n+Order)*(n+Order),1.0);
+    std::vector<double> values1(values0.size(),0.0);
+    for (lattice_iterator<D> it(min,max_all); it != false; ++it) {
+        values0[size_t(it)] = std::sin(0.1*(*it)[0]) + std::cos(0.2*(*it)[1]);
+    }
+    const double t_loop = time_it([&]() {
+        for (int step = 0; step < steps; ++step) {
+            for (lattice_iterator<D> it(min_domain,max_domain,stride); 
+                    it != false; ++it) {
+                const size_t base_index = size_t(it);
+                values1[base_index] = values0[base_index];
+                for (unsigned int d = 0; d < D; d++) {
+                    for (int j = -Order/2; j <= Order/2; j++) {
+                        const double coeff = coefficient<Order>(j);
+                        values1[base_index] += r*coeff*values0[base_index + j*stride[d]];
+                    }
+                }
+            }
+        }
+    });
+
+    halo_grid<double,D> u0(min,max,Order/2), u1(min,max,Order/2);
+    u0.all().for_each([&](const int_d& i) {
+        u0[i] = std::sin(0.1*(i[0]+Order/2)) + std::cos(0.2*(i[1]+Order/2));
+    });
+    const double t_apply = time_it([&]() {
+        for (int step = 0; step < steps; ++step) {
+            apply_stencil<typename laplacian_stencil<D,Order>::type>(
+                    u0,u1,u0.interior(),r,1.0);
+        }
+    });
+
+    double max_error = 0;
+    u1.interior().for_each([&](const int_d& i) {
+        const int_d j = {{i[0]+Order/2,i[1]+Order/2}};
+        max_error = std::max(max_error,
+                std::abs(u1[i]-values1[stride[0]*j[0]+stride[1]*j[1]]));
+    });
+    CHECK( max_error < 1e-12 );
+    std::cout << "D = "<<D<<" n = "<<n<<" order = "<<Order
+              << " test loop = "<<1e3*t_loop/steps<<" ms/step"
+              << " apply_stencil = "<<1e3*t_apply/steps<<" ms/step"
+              << " speedup = "<<t_loop/t_apply<<std::endl;
+}
+
+TEST_CASE( "stencil apply", "[benchmark][stencil]" ) {
+    benchmark_stencil<2>(2048,5);
+    benchmark_stencil<4>(2048,5);
+    benchmark_stencil<6>(2048,5);
+}
+
+TEST_CASE( "temporal blocking", "[benchmark][stencil]" ) {
+    const unsigned int D = 3;
+    typedef std::array<int,D> int_d;
+    typedef laplacian_stencil<D,2>::type laplacian;
+    const int n = 320;
+    const int steps = 8;
+    const double r = 0.1;
+    const int_d min = {{0,0,0}};
+    const int_d max = {{n,n,n}};
+    halo_grid<double,D> u0(min,max,1,1.0), u1(min,max,1,1.0);
+    halo_grid<double,D> v0(min,max,1,1.0), v1(min,max,1,1.0);
+
+    // effective bandwidth and flop rate, counting one read and one write of 
+    // every point per step, and 2 flops per tap plus the update
+    const double points = double(n)*n*n*steps;
+    const double bytes = points*2*sizeof(double);
+    const double flops = points*(2*laplacian::size() + 2);
+    auto report = [&](const char* name, const double t) {
+        std::cout << name << " = "<<1e3*t/steps<<" ms/step "
+                  << bytes/t/1e9<<" GB/s "<<flops/t/1e9<<" GFLOP/s"<<std::endl;
+    };
+
+    std::cout << "D = "<<D<<" n = "<<n<<" steps = "<<steps<<" grid = "
+              << u0.size()*sizeof(double)/1e6<<" MB"<<std::endl;
+    const double t_naive = time_it([&]() {
+        for (int step = 0; step < steps; ++step) {
+            apply_stencil<laplacian>(v0,v1,v0.interior(),r,1.0);
+            std::swap(v0,v1);
+        }
+    });
+    report("naive sweeps",t_naive);
+    for (const int block_width: {4,8,16,32}) {
+        std::fill(u0.data(),u0.data()+u0.size(),1.0);
+        std::fill(u1.data(),u1.data()+u1.size(),1.0);
+        const double t_blocked = time_it([&]() {
+            advance_stencil<laplacian>(u0,u1,u0.interior(),steps,r,1.0,
+                                       block_width);
+        });
+        CHECK( std::equal(u0.data(),u0.data()+u0.size(),v0.data()) );
+        std::cout << "block width = "<<block_width<<" ";
+        report("temporal blocking",t_blocked);
+        std::cout << "speedup = "<<t_naive/t_blocked<<std::endl;
+    }
+}
+
+TEST_CASE( "periodic stencil", "[benchmark][periodic]" ) {
+    const unsigned int D = 3;
+    typedef std::array<int,D> int_d;
+    typedef laplacian_stencil<D,4>::type laplacian;
+    const int n = 192;
+    const int steps = 5;
+    const double r = 0.05;
+    const int_d min = {{0,0,0}};
+    const int_d max = {{n,n,n}};
+    auto initial = [](const int_d& i) { 
+        return std::sin(0.1*i[0]) + std::cos(0.2*i[1]) + 0.01*i[2]; 
+    };
+
+    // the periodic images copied into a halo before every step, reading 
+    // them with periodic_lattice_iterator
+    halo_grid<double,D> h0(min,max,2), h1(min,max,2);
+    h0.interior().for_each([&](const int_d& i) { h0[i] = initial(i); });
+    const auto stride = h0.get_stride();
+    const std::ptrdiff_t origin = h0.get_mapping().get_origin();
+    auto copy_halo = [&]() {
+        double* const data = h0.data() - origin;
+        for (const auto& region: h0.halo()) {
+            periodic_lattice_iterator<D> src(min,max,region.begin().get_min(),
+                                             region.begin().get_max(),stride);
+            for (auto dst = region.begin(); dst != false; ++dst, ++src) {
+                data[size_t(dst)] = data[size_t(src)];
+            }
+        }
+    };
+    const double t_copy = time_it([&]() {
+        for (int step = 0; step < steps; ++step) copy_halo();
+    });
+    const double t_halo = time_it([&]() {
+        for (int step = 0; step < steps; ++step) {
+            copy_halo();
+            apply_stencil<laplacian>(h0,h1,h0.interior(),r,1.0);
+            std::swap(h0,h1);
+        }
+    });
+
+    // wrapped offsets in the shell of the domain, and no halo
+    grid<double,D> u0(min,max), u1(min,max);
+    u0.for_each([&](const int_d& i, double& value) { value = initial(i); });
+    const double t_periodic = time_it([&]() {
+        for (int step = 0; step < steps; ++step) {
+            apply_stencil_periodic<laplacian>(u0,u1,u0.range(),r,1.0);
+            std::swap(u0,u1);
+        }
+    });
+
+    double max_error = 0;
+    u0.for_each([&](const int_d& i, const double value) {
+        max_error = std::max(max_error,std::abs(value-h0[i]));
+    });
+    CHECK( max_error < 1e-12 );
+    std::cout << "D = "<<D<<" n = "<<n
+              << " halo copy = "<<1e3*t_copy/steps<<" ms/step"
+              << " halo copy + apply_stencil = "<<1e3*t_halo/steps<<" ms/step"
+              << " apply_stencil_periodic = "<<1e3*t_periodic/steps<<" ms/step"
+              << " speedup = "<<t_halo/t_periodic<<std::endl;
+}
+
+TEST_CASE( "ball iterator", "[benchmark][ball]" ) {
+    const unsigned int D = 3;
+    typedef std::array<int,D> int_d;
+    const int n = 64;
+    const int queries = 20000;
+    const int_d min = {{0,0,0}};
+    const int_d max = {{n,n,n}};
+    const auto stride = lattice_iterator<D>(min,max).get_stride();
+    std::vector<double> cells(n*n*n);
+    std::mt19937 generator;
+    std::uniform_real_distribution<double> uniform(0,1);
+    for (auto& c: cells) c = uniform(generator);
+    std::uniform_int_distribution<int> uniform_cell(0,n-1);
+    std::vector<int_d> centres(queries);
+    for (auto& c: centres) {
+        for (size_t i = 0; i < D; ++i) c[i] = uniform_cell(generator);
+    }
+
+    for (const double radius: {2.0,4.0,8.0}) {
+        const int r = static_cast<int>(radius);
+        long visited_box = 0;
+        double sum_box = 0;
+        const double t_box = time_it([&]() {
+            for (const int_d& c: centres) {
+                int_d box_min, box_max;
+                for (size_t i = 0; i < D; ++i) {
+                    box_min[i] = std::max(min[i],c[i]-r);
+                    box_max[i] = std::min(max[i],c[i]+r+1);
+                }
+                for (lattice_iterator<D> it(box_min,box_max,stride); 
+                        it != false; ++it) {
+                    ++visited_box;
+                    double d2 = 0;
+                    for (size_t i = 0; i < D; ++i) {
+                        d2 += double((*it)[i]-c[i])*((*it)[i]-c[i]);
+                    }
+                    if (d2 <= radius*radius) sum_box += cells[size_t(it)];
+                }
+            }
+        });
+
+        long visited_ball = 0;
+        double sum_ball = 0;
+        const double t_ball = time_it([&]() {
+            for (const int_d& c: centres) {
+                for (lattice_ball_iterator<D> it(min,max,c,radius); 
+                        it != false; ++it) {
+                    ++visited_ball;
+                    sum_ball += cells[size_t(it)];
+                }
+            }
+        });
+
+        double sum_for_each = 0;
+        const double t_for_each = time_it([&]() {
+            for (const int_d& c: centres) {
+                lattice::for_each(lattice_ball_iterator<D>(min,max,c,radius),false,
+                    [&](const int_d&, const std::ptrdiff_t j) { 
+                        sum_for_each += cells[j]; 
+                    });
+            }
+        });
+
+        CHECK( sum_ball == Approx(sum_box) );
+        CHECK( sum_for_each == Approx(sum_box) );
+        std::cout << "D = "<<D<<" radius = "<<radius
+                  << " wasted box visits = "
+                  << 100.0*(visited_box-visited_ball)/visited_box<<"%"
+                  << " box and filter = "<<1e9*t_box/queries<<" ns/query"
+                  << " ball iterator = "<<1e9*t_ball/queries<<" ns/query"
+                  << " ball for_each = "<<1e9*t_for_each/queries<<" ns/query"
+                  << " speedup = "<<t_box/t_for_each<<std::endl;
+    }
+}
+
+TEST_CASE( "half shell", "[benchmark][half_shell]" ) {
+    const unsigned int D = 3;
+    typedef std::array<int,D> int_d;
+    typedef std::array<double,D> double_d;
+    const int n = 24;
+    const int per_cell = 8;
+    const int_d min = {{0,0,0}};
+    const int_d max = {{n,n,n}};
+    const auto stride = lattice_iterator<D>(min,max).get_stride();
+
+    // particles sorted by cell, with unit cells and the interaction cutoff
+    std::vector<double_d> x;
+    std::vector<size_t> cell_begin(n*n*n+1);
+    std::mt19937 generator;
+    std::uniform_real_distribution<double> uniform(0,1);
+    for (lattice_iterator<D> it(min,max); it != false; ++it) {
+        cell_begin[size_t(it)] = x.size();
+        for (int p = 0; p < per_cell; ++p) {
+            double_d xp;
+            for (size_t i = 0; i < D; ++i) xp[i] = (*it)[i] + uniform(generator);
+            x.push_back(xp);
+        }
+    }
+    cell_begin[n*n*n] = x.size();
+
+    // a soft repulsion with cutoff 1, added to f[i] and subtracted from f[j] 
+    // if symmetric
+    auto interact = [&](std::vector<double_d>& f, const size_t i, 
+                        const size_t j, const bool symmetric) {
+        double_d dx;
+        double r2 = 0;
+        for (size_t d = 0; d < D; ++d) {
+            dx[d] = x[i][d]-x[j][d];
+            r2 += dx[d]*dx[d];
+        }
+        if (r2 >= 1.0 || r2 == 0.0) return;
+        const double scale = (1.0-r2)*(1.0-r2);
+        for (size_t d = 0; d < D; ++d) {
+            f[i][d] += scale*dx[d];
+            if (symmetric) f[j][d] -= scale*dx[d];
+        }
+    };
+
+    std::vector<double_d> f_full(x.size(),double_d{{0,0,0}});
+    const double t_full = time_it([&]() {
+        for (lattice_iterator<D> cell(min,max); cell != false; ++cell) {
+            int_d box_min, box_max;
+            for (size_t i = 0; i < D; ++i) {
+                box_min[i] = std::max(min[i],(*cell)[i]-1);
+                box_max[i] = std::min(max[i],(*cell)[i]+2);
+            }
+            for (lattice_iterator<D> other(box_min,box_max,stride); 
+                    other != false; ++other) {
+                for (size_t i = cell_begin[size_t(cell)]; 
+                        i < cell_begin[size_t(cell)+1]; ++i) {
+                    for (size_t j = cell_begin[size_t(other)]; 
+                            j < cell_begin[size_t(other)+1]; ++j) {
+                        interact(f_full,i,j,false);
+                    }
+                }
+            }
+        }
+    });
+
+    std::vector<double_d> f_half(x.size(),double_d{{0,0,0}});
+    const double t_half = time_it([&]() {
+        for (lattice_iterator<D> cell(min,max); cell != false; ++cell) {
+            const size_t begin = cell_begin[size_t(cell)];
+            const size_t end = cell_begin[size_t(cell)+1];
+            for (size_t i = begin; i < end; ++i) {
+                for (size_t j = i+1; j < end; ++j) {
+                    interact(f_half,i,j,true);
+                }
+            }
+            for (auto other = half_shell_begin(*cell,min,max,stride); 
+                    other != false; ++other) {
+                for (size_t i = begin; i < end; ++i) {
+                    for (size_t j = cell_begin[size_t(other)]; 
+                            j < cell_begin[size_t(other)+1]; ++j) {
+                        interact(f_half,i,j,true);
+                    }
+                }
+            }
+        }
+    });
+
+    double max_error = 0;
+    for (size_t i = 0; i < x.size(); ++i) {
+        for (size_t d = 0; d < D; ++d) {
+            max_error = std::max(max_error,std::abs(f_full[i][d]-f_half[i][d]));
+        }
+    }
+    CHECK( max_error < 1e-10 );
+    std::cout << "D = "<<D<<" cells = "<<n*n*n<<" particles = "<<x.size()
+              << " full shell = "<<1e3*t_full<<" ms"
+              << " half shell = "<<1e3*t_half<<" ms"
+              << " speedup = "<<t_full/t_half<<std::endl;
+}
+
+TEST_CASE( "simplex iterator", "[benchmark][simplex]" ) {
+    const unsigned int D = 3;
+    typedef std::array<int,D> int_d;
+    const int n = 320;
+    std::vector<double> x(n);
+    std::mt19937 generator;
+    std::uniform_real_distribution<double> uniform(0,1);
+    for (auto& xi: x) xi = uniform(generator);
+    auto triplet = [&](const int_d& i) { return x[i[0]]*x[i[1]]*x[i[2]]; };
+
+    double sum_filter = 0;
+    const double t_filter = time_it([&]() {
+        for (lattice_iterator<D> it(int_d{{0,0,0}},int_d{{n,n,n}}); 
+                it != false; ++it) {
+            if ((*it)[0] < (*it)[1] && (*it)[1] < (*it)[2]) {
+                sum_filter += triplet(*it);
+            }
+        }
+    });
+
+    double sum_simplex = 0;
+    const double t_simplex = time_it([&]() {
+        for (simplex_iterator<D> it(n); it != false; ++it) {
+            sum_simplex += triplet(*it);
+        }
+    });
+
+    double sum_loops = 0;
+    const double t_loops = time_it([&]() {
+        for (int i = 0; i < n; ++i) {
+            for (int j = i+1; j < n; ++j) {
+                for (int k = j+1; k < n; ++k) {
+                    sum_loops += triplet(int_d{{i,j,k}});
+                }
+            }
+        }
+    });
+
+    CHECK( sum_simplex == Approx(sum_filter) );
+    CHECK( sum_loops == Approx(sum_filter) );
+    std::cout << "D = "<<D<<" n = "<<n<<" tuples = "<<simplex_iterator<D>(n).size()
+              << " box and filter = "<<1e3*t_filter<<" ms"
+              << " simplex_iterator = "<<1e3*t_simplex<<" ms"
+              << " nested loops = "<<1e3*t_loops<<" ms"
+              << " speedup = "<<t_filter/t_simplex<<std::endl;
+}
+
+TEST_CASE( "masked range", "[benchmark][masked]" ) {
+    const unsigned int D = 3;
+    typedef std::array<int,D> int_d;
+    const int n = 256;
+    const int repeats = 5;
+    const int_d min = {{0,0,0}};
+    const int_d max = {{n,n,n}};
+    // an irregular domain, two overlapping balls covering about a fifth of the box
+    auto active = [&](const int_d& i) {
+        const double x = i[0]-0.4*n, y = i[1]-0.5*n, z = i[2]-0.45*n;
+        const double r2 = x*x + y*y + z*z;
+        const double w = i[0]-0.7*n;
+        return r2 < 0.33*0.33*n*n || w*w + y*y + z*z < 0.25*0.25*n*n;
+    };
+    const std::vector<uint64_t> mask = make_lattice_mask(min,max,active);
+    std::vector<double> values(n*n*n,1.0);
+
+    double sum_filter = 0;
+    const double t_filter = time_it([&]() {
+        for (int r = 0; r < repeats; ++r) {
+            lattice::for_each(min,max,[&](const int_d&, const std::ptrdiff_t p) {
+                if ((mask[p/64] >> (p%64)) & 1) sum_filter += values[p];
+            });
+        }
+    });
+
+    masked_lattice_range<D> range(min,max,mask);
+    const double t_encode = time_it([&]() {
+        masked_lattice_range<D> tmp(min,max,mask);
+        CHECK( tmp.size() == range.size() );
+    });
+
+    double sum_iterator = 0;
+    const double t_iterator = time_it([&]() {
+        for (int r = 0; r < repeats; ++r) {
+            for (auto it = range.begin(); it != false; ++it) {
+                sum_iterator += values[size_t(it)];
+            }
+        }
+    });
+
+    double sum_for_each = 0;
+    const double t_for_each = time_it([&]() {
+        for (int r = 0; r < repeats; ++r) {
+            range.for_each([&](const int_d&, const std::ptrdiff_t p) {
+                sum_for_each += values[p];
+            });
+        }
+    });
+
+    CHECK( sum_iterator == sum_filter );
+    CHECK( sum_for_each == sum_filter );
+    std::cout << "D = "<<D<<" n = "<<n
+              << " active = "<<100.0*range.size()/(double(n)*n*n)<<"%"
+              << " spans = "<<range.get_spans().size()
+              << " encode = "<<1e3*t_encode<<" ms"<<std::endl;
+    std::cout << "box and bitmap test = "<<1e3*t_filter/repeats<<" ms"
+              << " masked iterator = "<<1e3*t_iterator/repeats<<" ms"
+              << " masked for_each = "<<1e3*t_for_each/repeats<<" ms"
+              << " speedup = "<<t_filter/t_for_each<<std::endl;
+}
+
+TEST_CASE( "red-black gauss-seidel", "[benchmark][coloured]" ) {
+    const unsigned int D = 2;
+    typedef std::array<int,D> int_d;
+    const int n = 2048;
+    const int sweeps = 5;
+    const int_d min = {{1,1}};
+    const int_d max = {{n-1,n-1}};
+    const auto stride = lattice_iterator<D>(int_d{{0,0}},int_d{{n,n}}).get_stride();
+    std::vector<double> u0(n*n,1.0), u1(n*n,1.0);
+    for (size_t i = 0; i < u0.size(); i += 7) {
+        u0[i] = u1[i] = 0.0;
+    }
+    auto update = [&](std::vector<double>& u, const std::ptrdiff_t j) {
+        u[j] = 0.25*(u[j-stride[0]] + u[j+stride[0]] + u[j-1] + u[j+1]);
+    };
+
+    const double t_filter = time_it([&]() {
+        for (int sweep = 0; sweep < sweeps; ++sweep) {
+            for (int colour = 0; colour < 2; ++colour) {
+                for (lattice_iterator<D> it(min,max,stride); it != false; ++it) {
+                    if (((*it)[0] + (*it)[1]) % 2 == colour) {
+                        update(u0,size_t(it));
+                    }
+                }
+            }
+        }
+    });
+    const double t_coloured = time_it([&]() {
+        for (int sweep = 0; sweep < sweeps; ++sweep) {
+            for (int colour = 0; colour < 2; ++colour) {
+                lattice::for_each(
+                    coloured_lattice_iterator<D>(min,max,stride,colour),false,
+                    [&](const int_d&, const std::ptrdiff_t j) { update(u1,j); });
+            }
+        }
+    });
+    CHECK( u0 == u1 );
+    std::cout << "D = "<<D<<" n = "<<n
+              << " box and filter = "<<1e3*t_filter/sweeps<<" ms/sweep"
+              << " coloured = "<<1e3*t_coloured/sweeps<<" ms/sweep"
+              << " speedup = "<<t_filter/t_coloured<<std::endl;
+}
+
+// one level of a geometric multigrid solver for -laplace(u) = f on the unit 
+// square with u = 0 on the boundary, using n x n points with n = 2^k+1
+struct multigrid_level {
+    typedef std::array<int,2> int_d;
+    int n;
+    double h;
+    lattice_iterator<2>::stride_type stride;
+    std::vector<double> u, f, r;
+
+    explicit multigrid_level(const int n):
+        n(n),
+        h(1.0/(n-1)),
+        stride(lattice_iterator<2>(int_d{{0,0}},int_d{{n,n}}).get_stride()),
+        u(n*n,0.0), f(n*n,0.0), r(n*n,0.0) 
+    {}
+
+    int_d interior_min() const { return int_d{{1,1}}; }
+    int_d interior_max() const { return int_d{{n-1,n-1}}; }
+
+    void smooth(const int sweeps) {
+        const std::ptrdiff_t s = stride[0];
+        const double h2 = h*h;
+        double* const pu = u.data();
+        const double* const pf = f.data();
+        for (int sweep = 0; sweep < sweeps; ++sweep) {
+            for (int colour = 0; colour < 2; ++colour) {
+                lattice::for_each(
+                    coloured_lattice_iterator<2>(interior_min(),interior_max(),
+                                                 stride,colour),false,
+                    [&](const int_d&, const std::ptrdiff_t j) { 
+                        pu[j] = 0.25*(pu[j-s] + pu[j+s] + pu[j-1] + pu[j+1] 
+                                      + h2*pf[j]);
+                    });
+            }
+        }
+    }
+
+    double residual() {
+        const std::ptrdiff_t s = stride[0];
+        const double inv_h2 = 1.0/(h*h);
+        double norm = 0;
+        lattice::for_each(
+            lattice_iterator<2>(interior_min(),interior_max(),stride),false,
+            [&](const int_d&, const std::ptrdiff_t j) { 
+                r[j] = f[j] - inv_h2*(4*u[j] - u[j-s] - u[j+s] - u[j-1] - u[j+1]);
+                norm += r[j]*r[j];
+            });
+        return std::sqrt(norm*h*h);
+    }
+};
+
+// full weighting of the fine residual onto the coarse right hand side. The 
+// fine points under the coarse interior are visited with a step-2 iterator 
+// in the same order as the coarse interior, so the two advance in lockstep
+void restrict_residual(const multigrid_level& fine, multigrid_level& coarse) {
+    typedef std::array<int,2> int_d;
+    const std::ptrdiff_t s = fine.stride[0];
+    const double* const r = fine.r.data();
+    lattice_iterator<2> coarse_it(coarse.interior_min(),coarse.interior_max(),
+                                  coarse.stride);
+    lattice_iterator<2> fine_it(int_d{{2,2}},int_d{{fine.n-1,fine.n-1}},
+                                fine.stride,int_d{{2,2}});
+    for (; fine_it != false; ++fine_it, ++coarse_it) {
+        const std::ptrdiff_t j = size_t(fine_it);
+        coarse.f[size_t(coarse_it)] = 
+            0.25*r[j] 
+            + 0.125*(r[j-s] + r[j+s] + r[j-1] + r[j+1])
+            + 0.0625*(r[j-s-1] + r[j-s+1] + r[j+s-1] + r[j+s+1]);
+        coarse.u[size_t(coarse_it)] = 0;
+    }
+}
+
+// bilinear interpolation of the coarse correction onto the fine grid, one 
+// step-2 iterator for each parity class of fine points
+void prolongate_correction(const multigrid_level& coarse, multigrid_level& fine) {
+    typedef std::array<int,2> int_d;
+    const std::ptrdiff_t s = coarse.stride[0];
+    const double* const e = coarse.u.data();
+    for (int a = 0; a < 2; ++a) {
+        for (int b = 0; b < 2; ++b) {
+            const double weight = 1.0/((1+a)*(1+b));
+            lattice::for_each(
+                lattice_iterator<2>(int_d{{2-a,2-b}},int_d{{fine.n-1,fine.n-1}},
+                                    fine.stride,int_d{{2,2}}),false,
+                [&](const int_d& index, const std::ptrdiff_t j) {
+                    const std::ptrdiff_t c = (index[0]/2)*s + index[1]/2;
+                    fine.u[j] += weight*(e[c] + a*e[c+s] + b*e[c+1] 
+                                         + a*b*e[c+s+1]);
+                });
+        }
+    }
+}
+
+void v_cycle(std::vector<multigrid_level>& levels, const size_t l) {
+    multigrid_level& fine = levels[l];
+    if (l+1 == levels.size()) {
+        // a single interior point, one sweep solves it exactly
+        fine.smooth(1);
+        return;
+    }
+    fine.smooth(2);
+    fine.residual();
+    restrict_residual(fine,levels[l+1]);
+    v_cycle(levels,l+1);
+    prolongate_correction(levels[l+1],fine);
+    fine.smooth(2);
+}
+
+TEST_CASE( "multigrid v-cycle", "[benchmark][stepped]" ) {
+    typedef std::array<int,2> int_d;
+    const int k = 11;
+    const int cycles = 5;
+    std::vector<multigrid_level> levels;
+    for (int l = k; l >= 1; --l) {
+        levels.emplace_back((1<<l)+1);
+    }
+    multigrid_level& top = levels[0];
+    for (lattice_iterator<2> it(top.interior_min(),top.interior_max(),top.stride); 
+            it != false; ++it) {
+        const double x = (*it)[0]*top.h;
+        const double y = (*it)[1]*top.h;
+        top.f[size_t(it)] = std::sin(3*x)*std::cos(5*y) + 1.0;
+    }
+
+    // restriction alone, stepped iterator versus filtering the fine box
+    top.residual();
+    multigrid_level& coarse = levels[1];
+    const int repeats = 10;
+    const double t_stepped = time_it([&]() {
+        for (int i = 0; i < repeats; ++i) restrict_residual(top,coarse);
+    });
+    const std::vector<double> f_stepped = coarse.f;
+    const double t_filter = time_it([&]() {
+        for (int i = 0; i < repeats; ++i) {
+            const std::ptrdiff_t s = top.stride[0];
+            const double* const r = top.r.data();
+            for (lattice_iterator<2> it(top.interior_min(),top.interior_max(),
+                                        top.stride); it != false; ++it) {
+                const int_d index = *it;
+                if (index[0] % 2 != 0 || index[1] % 2 != 0) continue;
+                const std::ptrdiff_t j = size_t(it);
+                coarse.f[(index[0]/2)*coarse.stride[0] + index[1]/2] = 
+                    0.25*r[j] 
+                    + 0.125*(r[j-s] + r[j+s] + r[j-1] + r[j+1])
+                    + 0.0625*(r[j-s-1] + r[j-s+1] + r[j+s-1] + r[j+s+1]);
+            }
+        }
+    });
+    CHECK( coarse.f == f_stepped );
+
+    const double r0 = top.residual();
+    double r = r0;
+    double worst_factor = 0;
+    const double t_cycle = time_it([&]() {
+        for (int cycle = 0; cycle < cycles; ++cycle) {
+            v_cycle(levels,0);
+            const double r_new = top.residual();
+            worst_factor = std::max(worst_factor,r_new/r);
+            r = r_new;
+        }
+    });
+    CHECK( worst_factor < 0.2 );
+    std::cout << "n = "<<top.n
+              << " restriction box and filter = "<<1e3*t_filter/repeats<<" ms"
+              << " stepped = "<<1e3*t_stepped/repeats<<" ms"
+              << " speedup = "<<t_filter/t_stepped<<std::endl;
+    std::cout << "n = "<<top.n<<" levels = "<<levels.size()
+              << " v-cycle = "<<1e3*t_cycle/cycles<<" ms"
+              << " residual "<<r0<<" -> "<<r
+              << " worst reduction factor = "<<worst_factor<<std::endl;
+}
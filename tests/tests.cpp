@@ -2,6 +2,13 @@
 #define CATCH_CONFIG_MAIN  // This tells Catch to provide a main() - only do this in one cpp file
 #include "catch.hpp"
 #include "lattice.h"
+#include <map>
+#if __cplusplus >= 201703L
+#if __has_include(<execution>)
+#include <execution>
+#define HAVE_EXECUTION_POLICIES
+#endif
+#endif
 using namespace lattice;
 
 TEST_CASE( "iterators work", "[iterator]" ) {
@@ -60,7 +67,7 @@ TEST_CASE( "iterators work", "[iterator]" ) {
 
         SECTION( "fori loop" ) {
             int count = 0;
-            for (size_t i = 0; i < end-it; ++i) {
+            for (std::ptrdiff_t i = 0; i < end-it; ++i) {
                 ++count;
             }
 
@@ -97,6 +104,1452 @@ TEST_CASE( "iterators work", "[iterator]" ) {
     }
 }
 
+TEST_CASE( "random access", "[iterator]" ) {
+    const unsigned int D = 3;
+    typedef std::array<int,D> int_d;
+
+    const int_d min = {{-1,2,0}};
+    const int_d max = {{3,5,7}};
+    lattice_iterator<D> begin(min,max);
+    lattice_iterator<D> end;
+
+    SECTION( "jumps match increments" ) {
+        lattice_iterator<D> it = begin;
+        for (int n = 0; it != false; ++it, ++n) {
+            REQUIRE( *(begin + n) == *it );
+            REQUIRE( size_t(it - begin) == size_t(n) );
+            REQUIRE( size_t(end - it) == size_t(4*3*7 - n) );
+        }
+    }
+
+    SECTION( "jump past the end" ) {
+        REQUIRE( (begin + 4*3*7) == false );
+        REQUIRE( *(begin + (4*3*7 - 1)) == (int_d{{2,4,6}}) );
+    }
+
+    SECTION( "linear offset" ) {
+        const lattice_iterator<D>::stride_type stride = {{100,10,1}};
+        lattice_iterator<D> it(min,max,stride);
+        for (; it != false; ++it) {
+            const int_d index = *it;
+            REQUIRE( size_t(it) == size_t(100*index[0] + 10*index[1] + index[2]) );
+            REQUIRE( size_t(begin + (it - lattice_iterator<D>(min,max,stride))) 
+                        == size_t(index[0]*3*7 + index[1]*7 + index[2]) );
+        }
+    }
+
+    SECTION( "empty box" ) {
+        lattice_iterator<2> empty({{0,0}},{{2,0}});
+        REQUIRE( empty == false );
+        REQUIRE( empty == lattice_iterator<2>() );
+        REQUIRE( lattice_iterator<2>({{0,0}},{{0,3}}) == false );
+        REQUIRE( lattice_iterator<2>({{0,0}},{{-1,-1}}) == false );
+        REQUIRE( (empty + 0) == false );
+        REQUIRE( (empty + 3) == false );
+        REQUIRE( (lattice_iterator<2>() - empty) == 0 );
+    }
+
+    SECTION( "magic number division" ) {
+        const std::array<uint64_t,6> divisors = {{1,3,7,64,1000003,
+                                                  (uint64_t(1)<<63)+5}};
+        const std::array<uint64_t,5> numerators = {{0,1,12345678,
+                                                    (uint64_t(1)<<40)+17,
+                                                    ~uint64_t(0)}};
+        for (auto d: divisors) {
+            const divider div(d);
+            for (auto n: numerators) {
+                REQUIRE( div.divide(n) == n/d );
+            }
+        }
+    }
+}
+
+TEST_CASE( "stepped iterator", "[iterator]" ) {
+    const unsigned int D = 3;
+    typedef std::array<int,D> int_d;
+
+    const int_d min = {{-1,2,0}};
+    const int_d max = {{6,9,4}};
+    const int_d step = {{2,3,1}};
+    const auto stride = lattice_iterator<D>(min,max).get_stride();
+    lattice_iterator<D> begin(min,max,stride,step);
+    lattice_iterator<D> end;
+
+    std::vector<int_d> expected;
+    for (lattice_iterator<D> it(min,max); it != false; ++it) {
+        bool on_step = true;
+        for (size_t i = 0; i < D; ++i) {
+            if (((*it)[i]-min[i]) % step[i] != 0) on_step = false;
+        }
+        if (on_step) expected.push_back(*it);
+    }
+    // ceil(7/2)*ceil(7/3)*4 points
+    REQUIRE( expected.size() == 4*3*4 );
+
+    SECTION( "increment" ) {
+        lattice_iterator<D> it = begin;
+        for (size_t n = 0; n < expected.size(); ++n, ++it) {
+            REQUIRE( it != false );
+            REQUIRE( *it == expected[n] );
+            const int_d index = *it;
+            REQUIRE( size_t(it) == size_t(stride[0]*index[0] + stride[1]*index[1]
+                                          + index[2]) );
+        }
+        REQUIRE( it == false );
+    }
+
+    SECTION( "random access" ) {
+        REQUIRE( size_t(end - begin) == expected.size() );
+        lattice_iterator<D> it = begin;
+        for (int n = 0; it != false; ++it, ++n) {
+            REQUIRE( *(begin + n) == *it );
+            REQUIRE( size_t(begin + n) == size_t(it) );
+            REQUIRE( it - begin == n );
+        }
+        REQUIRE( (begin + expected.size()) == false );
+    }
+
+    SECTION( "decrement" ) {
+        lattice_iterator<D> it = begin + expected.size();
+        for (int n = expected.size()-1; n >= 0; --n) {
+            --it;
+            REQUIRE( *it == expected[n] );
+            REQUIRE( size_t(it) == size_t(begin + n) );
+        }
+    }
+
+    SECTION( "for_each" ) {
+        size_t n = 0;
+        lattice::for_each(begin,false,[&](const int_d& index, const size_t offset) {
+            REQUIRE( index == expected[n] );
+            REQUIRE( offset == size_t(begin + n) );
+            ++n;
+        });
+        REQUIRE( n == expected.size() );
+    }
+
+    SECTION( "step back from past the end" ) {
+        typedef std::array<int,1> int1;
+        const lattice_iterator<1> b1(int1{{0}},int1{{5}},
+                                     lattice_iterator<1>::stride_type{{1}},
+                                     int1{{2}});
+        REQUIRE( *((b1 + 3) - 1) == (int1{{4}}) );
+        // jumps further past the end stop at the end
+        REQUIRE( *((b1 + 7) - 1) == (int1{{4}}) );
+        REQUIRE( (b1 + 3) - b1 == 3 );
+
+        typedef std::array<int,2> int2;
+        const lattice_iterator<2> b2(int2{{0,0}},int2{{5,3}},
+                                     lattice_iterator<2>::stride_type{{3,1}},
+                                     int2{{2,1}});
+        REQUIRE( *((b2 + 9) - 1) == (int2{{4,2}}) );
+        REQUIRE( *(--(b2 + 9)) == (int2{{4,2}}) );
+        REQUIRE( (b2 + 9) - b2 == 9 );
+        REQUIRE( (b2 + 9) == (b2 + 8) + 1 );
+
+        REQUIRE( *((begin + expected.size()) - 3) == expected[expected.size()-3] );
+        lattice_iterator<D> walked = begin + (expected.size()-1);
+        ++walked;
+        REQUIRE( walked == false );
+        REQUIRE( walked - begin == std::ptrdiff_t(expected.size()) );
+        REQUIRE( *(walked - 1) == expected.back() );
+    }
+
+    SECTION( "unit steps" ) {
+        const int_d unit = {{1,1,1}};
+        lattice_iterator<D> it(min,max,stride,unit);
+        for (lattice_iterator<D> ref(min,max); ref != false; ++ref, ++it) {
+            REQUIRE( *it == *ref );
+            REQUIRE( size_t(it) == size_t(ref) );
+        }
+    }
+}
+
+TEST_CASE( "large lattices", "[iterator]" ) {
+    const unsigned int D = 3;
+    typedef std::array<int,D> int_d;
+    const int n = 2048;
+
+    auto range = make_iterator_range(
+                    lattice_iterator<D>(int_d{{0,0,0}},int_d{{n,n,n}}),
+                    lattice_iterator<D>());
+    const size_t total = size_t(n)*n*n;
+
+    REQUIRE( range.size() == total );
+
+    auto last = range.begin() + (total-1);
+    REQUIRE( *last == (int_d{{n-1,n-1,n-1}}) );
+    REQUIRE( size_t(last) == total-1 );
+    REQUIRE( size_t(last - range.begin()) == total-1 );
+    REQUIRE( ++last == false );
+
+    SECTION( "small index type" ) {
+        lattice_iterator<D,int,int> it(int_d{{0,0,0}},int_d{{4,5,6}});
+        REQUIRE( *(it + 119) == (int_d{{3,4,5}}) );
+        REQUIRE( size_t(lattice_iterator<D,int,int>() - it) == 120 );
+    }
+}
+
+TEST_CASE( "static lattice iterator", "[iterator]" ) {
+    const unsigned int D = 3;
+    typedef std::array<int,D> int_d;
+    typedef extents<4,dynamic_extent,6> extents_type;
+
+    const extents_type shape(5);
+    static_lattice_iterator<extents_type> it(shape);
+    static_lattice_iterator<extents_type> end;
+    lattice_iterator<D> dynamic_it(int_d{{0,0,0}},int_d{{4,5,6}});
+
+    REQUIRE( shape.extent<0>() == 4 );
+    REQUIRE( shape.extent<1>() == 5 );
+    REQUIRE( extents_type::rank_dynamic == 1 );
+    REQUIRE( it.get_stride() == dynamic_it.get_stride() );
+    REQUIRE( size_t(end - it) == 4*5*6 );
+
+    SECTION( "matches lattice_iterator" ) {
+        int count = 0;
+        for (; it != false; ++it, ++dynamic_it, ++count) {
+            REQUIRE( *it == *dynamic_it );
+            REQUIRE( size_t(it) == size_t(dynamic_it) );
+        }
+        REQUIRE( dynamic_it == false );
+        REQUIRE( count == 4*5*6 );
+    }
+
+    SECTION( "random access" ) {
+        for (int n = 0; n < 4*5*6; ++n) {
+            REQUIRE( *(it + n) == *(dynamic_it + n) );
+        }
+        REQUIRE( (it + 4*5*6) == end );
+    }
+
+    SECTION( "range loop" ) {
+        int count = 0;
+        for (const auto& index: make_iterator_range(it,end)) {
+            count += index[0] < 4;
+        }
+        REQUIRE( count == 4*5*6 );
+    }
+
+    SECTION( "empty extent" ) {
+        typedef extents<3,dynamic_extent> empty_type;
+        static_lattice_iterator<empty_type> empty(empty_type(0));
+        REQUIRE( empty == false );
+        REQUIRE( empty == static_lattice_iterator<empty_type>() );
+        REQUIRE( (static_lattice_iterator<empty_type>() - empty) == 0 );
+    }
+}
+
+TEST_CASE( "for_each", "[iterator]" ) {
+    const unsigned int D = 3;
+    typedef std::array<int,D> int_d;
+
+    const int_d min = {{-1,2,0}};
+    const int_d max = {{3,5,7}};
+    auto range = make_iterator_range(lattice_iterator<D>(min,max),false);
+
+    std::vector<int_d> expected;
+    std::vector<size_t> expected_offsets;
+    for (auto it = range.begin(); it != false; ++it) {
+        expected.push_back(*it);
+        expected_offsets.push_back(size_t(it));
+    }
+
+    SECTION( "nested loops" ) {
+        std::vector<int_d> visited;
+        lattice::for_each(min,max,[&](const int_d& index) {
+            visited.push_back(index);
+        });
+        REQUIRE( visited == expected );
+    }
+
+    SECTION( "range member with offsets" ) {
+        std::vector<int_d> visited;
+        std::vector<size_t> offsets;
+        range.for_each([&](const int_d& index, const std::ptrdiff_t offset) {
+            visited.push_back(index);
+            offsets.push_back(offset);
+        });
+        REQUIRE( visited == expected );
+        REQUIRE( offsets == expected_offsets );
+    }
+
+    SECTION( "begin part way through the box" ) {
+        std::vector<int_d> visited;
+        auto part = make_iterator_range(range.begin() + 10,false);
+        part.for_each([&](const int_d& index) {
+            visited.push_back(index);
+        });
+        REQUIRE( visited == std::vector<int_d>(expected.begin()+10,
+                                               expected.end()) );
+    }
+
+    SECTION( "end part way through the box" ) {
+        std::vector<int_d> visited;
+        auto part = make_iterator_range(range.begin(),range.begin() + 5);
+        part.for_each([&](const int_d& index) {
+            visited.push_back(index);
+        });
+        REQUIRE( visited == std::vector<int_d>(expected.begin(),
+                                               expected.begin()+5) );
+        visited.clear();
+        lattice::for_each(range.begin() + 10,range.begin() + 20,
+                          [&](const int_d& index) {
+            visited.push_back(index);
+        });
+        REQUIRE( visited == std::vector<int_d>(expected.begin()+10,
+                                               expected.begin()+20) );
+        // the end iterator of the box still takes the nested loops
+        visited.clear();
+        lattice::for_each(range.begin(),lattice_iterator<D>(),
+                          [&](const int_d& index) {
+            visited.push_back(index);
+        });
+        REQUIRE( visited == expected );
+    }
+
+    SECTION( "empty box" ) {
+        int count = 0;
+        lattice::for_each(min,int_d{{3,2,7}},[&](const int_d&) { ++count; });
+        REQUIRE( count == 0 );
+    }
+}
+
+TEST_CASE( "row iterator", "[iterator]" ) {
+    const unsigned int D = 3;
+    typedef std::array<int,D> int_d;
+
+    const int_d min = {{-1,2,1}};
+    const int_d max = {{3,5,7}};
+    lattice_iterator<D> points(min,max);
+    auto rows = make_iterator_range(lattice_row_iterator<D>(points),
+                                    lattice_row_iterator<D>());
+
+    REQUIRE( rows.size() == 4*3 );
+    REQUIRE( make_iterator_range(lattice_row_iterator<D>(points),false).size()
+                == 4*3 );
+
+    SECTION( "rows cover the box in order" ) {
+        int count = 0;
+        for (const auto& row: rows) {
+            REQUIRE( row.begin == 1 );
+            REQUIRE( row.end == 7 );
+            REQUIRE( row.size() == 6 );
+            int_d index = row.index;
+            for (int i = row.begin; i < row.end; ++i, ++points, ++count) {
+                index[D-1] = i;
+                REQUIRE( index == *points );
+                REQUIRE( size_t(row.offset + (i-row.begin)*row.stride) 
+                            == size_t(points) );
+            }
+        }
+        REQUIRE( points == false );
+        REQUIRE( count == 4*3*6 );
+    }
+
+    SECTION( "random access" ) {
+        const auto row = *(rows.begin() + 5);
+        REQUIRE( row.index == (int_d{{0,4,1}}) );
+        REQUIRE( size_t(row.offset) == size_t(points + 5*6) );
+        REQUIRE( (rows.begin() + 5)->index == row.index );
+        REQUIRE( (rows.begin() + 5)->size() == 6 );
+    }
+
+    SECTION( "empty rows" ) {
+        lattice_row_iterator<2> empty({{0,0}},{{3,0}});
+        REQUIRE( empty == false );
+        REQUIRE( empty == lattice_row_iterator<2>() );
+        REQUIRE( (lattice_row_iterator<2>() - empty) == 0 );
+    }
+
+    SECTION( "one dimension" ) {
+        int count = 0;
+        for (const auto& row: make_iterator_range(
+                    lattice_row_iterator<1>({{2}},{{9}}),
+                    lattice_row_iterator<1>())) {
+            count += row.size();
+        }
+        REQUIRE( count == 7 );
+    }
+}
+
+TEST_CASE( "splittable range", "[range]" ) {
+    const unsigned int D = 3;
+    typedef std::array<int,D> int_d;
+    typedef lattice_range<D> range_type;
+
+    const int_d min = {{-1,2,0}};
+    const int_d max = {{3,5,7}};
+    const size_t total = 4*3*7;
+
+    range_type range(min,max,7);
+    REQUIRE( range.size() == total );
+    REQUIRE( range.is_divisible() );
+
+    SECTION( "split along the longest dimension" ) {
+        range_type upper(range,split());
+        REQUIRE( range.get_max() == (int_d{{3,5,3}}) );
+        REQUIRE( upper.get_min() == (int_d{{-1,2,3}}) );
+        REQUIRE( range.size() + upper.size() == total );
+    }
+
+    SECTION( "recursive splitting visits every point once" ) {
+        std::vector<range_type> pieces(1,range);
+        for (size_t i = 0; i < pieces.size();) {
+            if (pieces[i].is_divisible()) {
+                pieces.push_back(range_type(pieces[i],split()));
+            } else {
+                ++i;
+            }
+        }
+        REQUIRE( pieces.size() > 1 );
+
+        std::vector<int> visits(total,0);
+        lattice_iterator<D> whole(min,max);
+        for (const auto& piece: pieces) {
+            REQUIRE( piece.size() <= 7 );
+            for (const auto& index: piece) {
+                REQUIRE( index == *(whole + (index[0]-min[0])*3*7 
+                                          + (index[1]-min[1])*7
+                                          + (index[2]-min[2])) );
+            }
+            piece.for_each([&](const int_d& index, std::ptrdiff_t offset) {
+                lattice_iterator<D> it = whole;
+                while (*it != index) ++it;
+                REQUIRE( size_t(it) == size_t(offset) );
+                ++visits[it - whole];
+            });
+        }
+        REQUIRE( std::count(visits.begin(),visits.end(),1) == int(total) );
+    }
+}
+
+TEST_CASE( "parallel for", "[range]" ) {
+    const unsigned int D = 3;
+    typedef std::array<int,D> int_d;
+
+    const int_d min = {{-1,2,0}};
+    const int_d max = {{30,25,17}};
+    const size_t total = 31*23*17;
+    lattice_range<D> range(min,max);
+    thread_pool pool(4);
+    REQUIRE( pool.size() == 4 );
+
+    SECTION( "every point visited once" ) {
+        std::vector<std::atomic<int>> visits(total);
+        for (auto& v: visits) v = 0;
+        for (int timestep = 0; timestep < 10; ++timestep) {
+            parallel_for(range,[&](const int_d&, const std::ptrdiff_t offset) {
+                ++visits[offset - size_t(range.begin())];
+            }, parallel_options<>(100,&pool));
+        }
+        for (auto& v: visits) {
+            REQUIRE( v == 10 );
+        }
+    }
+
+    SECTION( "iterator range and default pool" ) {
+        std::atomic<int> count(0);
+        parallel_for(make_iterator_range(lattice_iterator<D>(min,max),false),
+                     [&](const int_d&) { ++count; });
+        REQUIRE( count == int(total) );
+    }
+
+    SECTION( "partial and stepped iterator ranges" ) {
+        typedef std::array<int,2> int2;
+        const lattice_iterator<2> b(int2{{0,0}},int2{{4,4}});
+        std::vector<std::atomic<int>> visits(16);
+        std::atomic<int> wrong_offsets(0);
+        auto count = [&](const int2& index, const std::ptrdiff_t offset) {
+            if (offset != 4*index[0] + index[1]) ++wrong_offsets;
+            ++visits[offset];
+        };
+        auto check = [&](const std::vector<int>& expected) {
+            REQUIRE( wrong_offsets == 0 );
+            for (size_t i = 0; i < visits.size(); ++i) {
+                REQUIRE( visits[i] == expected[i] );
+                visits[i] = 0;
+            }
+        };
+        for (auto& v: visits) v = 0;
+        parallel_for(make_iterator_range(b + 10,false),count,
+                     parallel_options<>(1,&pool));
+        check({0,0,0,0, 0,0,0,0, 0,0,1,1, 1,1,1,1});
+        parallel_for(make_iterator_range(b + 3,b + 9),count,
+                     parallel_options<>(1,&pool));
+        check({0,0,0,1, 1,1,1,1, 1,0,0,0, 0,0,0,0});
+        parallel_for(make_iterator_range(lattice_iterator<2>(b),b + 5),count,
+                     parallel_options<>(1,&pool));
+        check({1,1,1,1, 1,0,0,0, 0,0,0,0, 0,0,0,0});
+        const lattice_iterator<2> stepped(b.get_min(),b.get_max(),
+                                          b.get_stride(),int2{{2,3}});
+        parallel_for(make_iterator_range(lattice_iterator<2>(stepped),false),
+                     count,parallel_options<>(1,&pool));
+        check({1,0,0,1, 0,0,0,0, 1,0,0,1, 0,0,0,0});
+    }
+
+    SECTION( "exceptions are rethrown" ) {
+        REQUIRE_THROWS_AS( 
+            parallel_for(range,[&](const int_d& index) {
+                if (index == int_d{{5,5,5}}) throw std::runtime_error("5");
+            }, parallel_options<>(100,&pool)), const std::runtime_error&);
+    }
+}
+
+TEST_CASE( "random access iterator requirements", "[iterator]" ) {
+    const unsigned int D = 3;
+    typedef std::array<int,D> int_d;
+    typedef lattice_iterator<D> iterator;
+
+    const int_d min = {{-1,2,0}};
+    const int_d max = {{3,5,7}};
+    const iterator begin(min,max);
+    const iterator end;
+    const std::ptrdiff_t total = 4*3*7;
+
+    REQUIRE( std::distance(begin,end) == total );
+    REQUIRE( end - begin == total );
+    REQUIRE( begin - end == -total );
+    REQUIRE( (begin + 5) - (begin + 12) == -7 );
+    REQUIRE( begin[13] == *(begin + 13) );
+    REQUIRE( *(13 + begin) == *(begin + 13) );
+    REQUIRE( begin < begin + 1 );
+    REQUIRE( begin + 1 > begin );
+    REQUIRE( begin <= begin );
+    REQUIRE( begin + (total-1) < end );
+    REQUIRE( !(end < begin + (total-1)) );
+    REQUIRE( begin + total == end );
+    REQUIRE( (begin + total) - begin == total );
+
+    SECTION( "decrement" ) {
+        iterator it = begin + total;
+        for (std::ptrdiff_t n = total-1; n >= 0; --n) {
+            --it;
+            REQUIRE( *it == *(begin + n) );
+            REQUIRE( size_t(it) == size_t(begin + n) );
+        }
+        REQUIRE( it == begin );
+    }
+
+    SECTION( "reverse iteration from the end of a range" ) {
+        lattice_range<D> range(min,max);
+        REQUIRE( range.end() == end );
+        REQUIRE( range.end() - range.begin() == total );
+        REQUIRE( *std::prev(range.end()) == (int_d{{2,4,6}}) );
+        std::ptrdiff_t n = total;
+        for (auto it = std::reverse_iterator<iterator>(range.end()); 
+             it != std::reverse_iterator<iterator>(range.begin()); ++it) {
+            --n;
+            REQUIRE( *it == *(begin + n) );
+        }
+        REQUIRE( n == 0 );
+        REQUIRE( lattice_range<D>(min,min).end() == end );
+    }
+
+    SECTION( "references outlive the iterator" ) {
+        iterator it = begin;
+        const auto& index = *it++;
+        REQUIRE( index == min );
+    }
+
+    SECTION( "binary search" ) {
+        const int_d target = {{1,3,4}};
+        auto found = std::lower_bound(begin,end,target);
+        REQUIRE( *found == target );
+        REQUIRE( found - begin == 2*3*7 + 1*7 + 4 );
+    }
+
+#ifdef HAVE_EXECUTION_POLICIES
+    SECTION( "parallel algorithms" ) {
+        std::vector<std::atomic<int>> visits(total);
+        for (auto& v: visits) v = 0;
+        std::for_each(std::execution::par_unseq,begin,end,
+                      [&](const int_d& index) {
+                          ++visits[(index[0]-min[0])*3*7 + 
+                                   (index[1]-min[1])*7 + 
+                                   (index[2]-min[2])];
+                      });
+        REQUIRE( std::all_of(visits.begin(),visits.end(),
+                    [](const std::atomic<int>& v) { return v == 1; }) );
+
+        const int sum = std::transform_reduce(std::execution::par,begin,end,0,
+                            std::plus<int>(),
+                            [](const int_d& index) { return index[2]; });
+        REQUIRE( sum == 4*3*(0+1+2+3+4+5+6) );
+    }
+#endif
+}
+
+TEST_CASE( "tiled iterator", "[iterator]" ) {
+    const unsigned int D = 3;
+    typedef std::array<int,D> int_d;
+    typedef tiled_lattice_iterator<D> iterator;
+
+    const int_d min = {{-1,2,0}};
+    const int_d max = {{6,7,9}};
+    const int_d tile = {{3,2,4}};
+    const std::ptrdiff_t total = 7*5*9;
+    const iterator begin(min,max,tile);
+    const lattice_iterator<D> row_major(min,max);
+
+    SECTION( "visits each point once, tile by tile" ) {
+        std::vector<int> visits(total,0);
+        int_d previous_tile = min;
+        std::ptrdiff_t n = 0;
+        for (iterator it = begin; it != false; ++it, ++n) {
+            const int_d index = *it;
+            int_d tile_min;
+            for (size_t i = 0; i < D; ++i) {
+                tile_min[i] = min[i] + (index[i]-min[i])/tile[i]*tile[i];
+            }
+            if (tile_min != previous_tile) {
+                // tiles are visited in row-major order
+                REQUIRE( previous_tile < tile_min );
+                REQUIRE( index == tile_min );
+                previous_tile = tile_min;
+            }
+            const std::ptrdiff_t position = (index[0]-min[0])*5*9 
+                                            + (index[1]-min[1])*9 
+                                            + (index[2]-min[2]);
+            REQUIRE( size_t(it) == size_t(row_major + position) );
+            REQUIRE( it - begin == n );
+            REQUIRE( *(begin + n) == index );
+            ++visits[position];
+        }
+        REQUIRE( n == total );
+        REQUIRE( std::count(visits.begin(),visits.end(),1) == total );
+    }
+
+    SECTION( "range with bool end" ) {
+        auto range = make_iterator_range(begin,false);
+        REQUIRE( range.size() == size_t(total) );
+        REQUIRE( (begin + total) == false );
+        REQUIRE( *(--(begin + total)) == *(begin + (total-1)) );
+    }
+
+    SECTION( "for_each" ) {
+        // whole box, part way into a tile, whole tiles (3*2*4 points each), 
+        // and within one tile
+        const std::vector<std::pair<std::ptrdiff_t,std::ptrdiff_t>> ranges = 
+            {{0,total},{13,total},{0,5},{13,100},{24,72},{25,27}};
+        for (auto r: ranges) {
+            std::vector<int_d> expected;
+            std::vector<size_t> expected_offsets;
+            for (iterator it = begin + r.first; it != begin + r.second; ++it) {
+                expected.push_back(*it);
+                expected_offsets.push_back(size_t(it));
+            }
+            std::vector<int_d> visited;
+            std::vector<size_t> offsets;
+            auto record = [&](const int_d& index, const std::ptrdiff_t offset) {
+                visited.push_back(index);
+                offsets.push_back(offset);
+            };
+            if (r.second == total) {
+                make_iterator_range(begin + r.first,false).for_each(record);
+            } else {
+                make_iterator_range(begin + r.first,begin + r.second)
+                    .for_each(record);
+            }
+            REQUIRE( visited == expected );
+            REQUIRE( offsets == expected_offsets );
+        }
+    }
+}
+
+TEST_CASE( "morton iterator", "[iterator]" ) {
+    SECTION( "bit interleaving" ) {
+        const std::array<int,3> index = {{5,1,7}};
+        // x = 101, y = 001, z = 111 gives xyz triples 101 001 111
+        REQUIRE( morton_encode<3>(index) == 0x14f );
+        REQUIRE( morton_decode<3>(0x14f) == index );
+        const std::array<int,2> big = {{2147483647,12345}};
+        REQUIRE( morton_decode<2>(morton_encode<2>(big)) == big );
+    }
+
+    SECTION( "next code in box" ) {
+        // box [1,2]x[1,2] in 2D, codes 3,6,9,12
+        const std::array<int,2> lo = {{1,1}};
+        const std::array<int,2> hi = {{2,2}};
+        const uint64_t zmin = morton_encode<2>(lo);
+        const uint64_t zmax = morton_encode<2>(hi);
+        REQUIRE( morton_next_in_box<2>(4,zmin,zmax) == 6 );
+        REQUIRE( morton_next_in_box<2>(7,zmin,zmax) == 9 );
+        REQUIRE( morton_next_in_box<2>(10,zmin,zmax) == 12 );
+    }
+
+    const unsigned int D = 3;
+    typedef std::array<int,D> int_d;
+    typedef morton_lattice_iterator<D> iterator;
+
+    for (const int_d max: {int_d{{7,12,9}},int_d{{7,11,11}}}) {
+        const int_d min = {{-1,3,3}};
+        const int_d size = {{max[0]-min[0],max[1]-min[1],max[2]-min[2]}};
+        const std::ptrdiff_t total = size[0]*size[1]*size[2];
+        const iterator begin(min,max);
+
+        std::vector<std::pair<uint64_t,int_d>> expected;
+        for (lattice_iterator<D> it(min,max); it != false; ++it) {
+            const int_d relative = {{(*it)[0]-min[0],(*it)[1]-min[1],
+                                     (*it)[2]-min[2]}};
+            expected.push_back(std::make_pair(morton_encode<D>(relative),*it));
+        }
+        std::sort(expected.begin(),expected.end());
+
+        std::ptrdiff_t n = 0;
+        lattice_iterator<D> row_major(min,max);
+        for (iterator it = begin; it != false; ++it, ++n) {
+            REQUIRE( *it == expected[n].second );
+            REQUIRE( it - begin == n );
+            REQUIRE( *(begin + n) == *it );
+            const int_d index = *it;
+            REQUIRE( size_t(it) == size_t(row_major + 
+                        (((index[0]-min[0])*size[1] + index[1]-min[1])*size[2] 
+                         + index[2]-min[2])) );
+        }
+        REQUIRE( n == total );
+        REQUIRE( make_iterator_range(begin,false).size() == size_t(total) );
+        REQUIRE( *(--(begin + total)) == expected.back().second );
+
+        // for_each passes the linear offset to a two argument f
+        n = 0;
+        lattice::for_each(begin,false,
+                [&](const int_d& index, const std::ptrdiff_t offset) {
+            REQUIRE( index == expected[n].second );
+            REQUIRE( size_t(offset) == size_t(begin + n) );
+            ++n;
+        });
+        REQUIRE( n == total );
+    }
+}
+
+TEST_CASE( "hilbert iterator", "[iterator]" ) {
+    SECTION( "collapse and reassemble" ) {
+        // the first order curve in 2D visits (0,0),(0,1),(1,1),(1,0)
+        REQUIRE( hilbert_reassemble<2>(1,1) == (std::array<int,2>{{0,1}}) );
+        REQUIRE( hilbert_reassemble<2>(2,1) == (std::array<int,2>{{1,1}}) );
+        REQUIRE( hilbert_reassemble<2>(3,1) == (std::array<int,2>{{1,0}}) );
+        for (unsigned int bits: {1u,4u,21u}) {
+            std::array<int,3> last = hilbert_reassemble<3>(0,bits);
+            REQUIRE( last == (std::array<int,3>{{0,0,0}}) );
+            for (uint64_t code = 1; code < 4096; ++code) {
+                if (bits == 1 && code == 8) break;
+                const std::array<int,3> index = hilbert_reassemble<3>(code,bits);
+                REQUIRE( hilbert_collapse<3>(index,bits) == code );
+                // consecutive points are neighbours
+                REQUIRE( std::abs(index[0]-last[0]) + std::abs(index[1]-last[1]) 
+                         + std::abs(index[2]-last[2]) == 1 );
+                last = index;
+            }
+        }
+    }
+
+    const unsigned int D = 3;
+    typedef std::array<int,D> int_d;
+    typedef hilbert_lattice_iterator<D> iterator;
+
+    for (const int_d max: {int_d{{7,12,9}},int_d{{7,11,11}},int_d{{3,5,5}}}) {
+        const int_d min = {{-1,3,3}};
+        const int_d size = {{max[0]-min[0],max[1]-min[1],max[2]-min[2]}};
+        const std::ptrdiff_t total = size[0]*size[1]*size[2];
+        const iterator begin(min,max);
+        unsigned int bits = 1;
+        while ((1 << bits) < *std::max_element(size.begin(),size.end())) ++bits;
+
+        std::vector<std::pair<uint64_t,int_d>> expected;
+        for (lattice_iterator<D> it(min,max); it != false; ++it) {
+            const int_d relative = {{(*it)[0]-min[0],(*it)[1]-min[1],
+                                     (*it)[2]-min[2]}};
+            expected.push_back(std::make_pair(
+                        hilbert_collapse<D>(relative,bits),*it));
+        }
+        std::sort(expected.begin(),expected.end());
+
+        std::ptrdiff_t n = 0;
+        lattice_iterator<D> row_major(min,max);
+        for (iterator it = begin; it != false; ++it, ++n) {
+            REQUIRE( *it == expected[n].second );
+            REQUIRE( it.get_code() == expected[n].first );
+            REQUIRE( it - begin == n );
+            REQUIRE( *(begin + n) == *it );
+            const int_d index = *it;
+            REQUIRE( size_t(it) == size_t(row_major + 
+                        (((index[0]-min[0])*size[1] + index[1]-min[1])*size[2] 
+                         + index[2]-min[2])) );
+        }
+        REQUIRE( n == total );
+        REQUIRE( make_iterator_range(begin,false).size() == size_t(total) );
+        REQUIRE( *(--(begin + total)) == expected.back().second );
+    }
+}
+
+TEST_CASE( "shell iterator", "[iterator]" ) {
+    const unsigned int D = 3;
+    typedef std::array<int,D> int_d;
+    typedef lattice_shell_iterator<D> iterator;
+    const int_d min = {{-1,3,2}};
+    for (const int_d max: {int_d{{7,12,9}},int_d{{0,8,9}},int_d{{4,8,5}}}) {
+        for (const int thickness: {1,2,3}) {
+            std::vector<int_d> expected;
+            for (lattice_iterator<D> it(min,max); it != false; ++it) {
+                bool shell = false;
+                for (size_t i = 0; i < D; ++i) {
+                    if ((*it)[i] < min[i]+thickness || 
+                        (*it)[i] >= max[i]-thickness) shell = true;
+                }
+                if (shell) expected.push_back(*it);
+            }
+            const iterator begin(min,max,thickness);
+            const auto stride = lattice_iterator<D>(min,max).get_stride();
+            std::ptrdiff_t n = 0;
+            for (iterator it = begin; it != false; ++it, ++n) {
+                REQUIRE( *it == expected[n] );
+                REQUIRE( it - begin == n );
+                REQUIRE( *(begin + n) == *it );
+                REQUIRE( size_t(it) == size_t(stride[0]*(*it)[0] 
+                            + stride[1]*(*it)[1] + stride[2]*(*it)[2]) );
+            }
+            REQUIRE( n == std::ptrdiff_t(expected.size()) );
+            REQUIRE( make_iterator_range(begin,false).size() == expected.size() );
+            REQUIRE( *(--(begin + n)) == expected.back() );
+        }
+    }
+}
+
+TEST_CASE( "coloured iterator", "[iterator]" ) {
+    const unsigned int D = 3;
+    typedef std::array<int,D> int_d;
+    typedef coloured_lattice_iterator<D> iterator;
+    const int_d min = {{-1,3,-2}};
+    for (const int_d max: {int_d{{4,7,9}},int_d{{2,5,0}},int_d{{1,4,-1}}}) {
+        const auto stride = lattice_iterator<D>(min,max).get_stride();
+        for (const int colours: {1,2,3,iterator::max_colours}) {
+            for (int colour = 0; colour < colours; ++colour) {
+                std::vector<int_d> expected;
+                for (lattice_iterator<D> it(min,max); it != false; ++it) {
+                    const int sum = (*it)[0] + (*it)[1] + (*it)[2];
+                    if (((sum % colours) + colours) % colours == colour) {
+                        expected.push_back(*it);
+                    }
+                }
+                const iterator begin(min,max,colour,colours);
+                std::ptrdiff_t n = 0;
+                for (iterator it = begin; it != false; ++it, ++n) {
+                    REQUIRE( *it == expected[n] );
+                    REQUIRE( it - begin == n );
+                    REQUIRE( *(begin + n) == *it );
+                    REQUIRE( size_t(it) == size_t(stride[0]*(*it)[0] 
+                                + stride[1]*(*it)[1] + stride[2]*(*it)[2]) );
+                }
+                REQUIRE( n == std::ptrdiff_t(expected.size()) );
+                REQUIRE( make_iterator_range(begin,false).size() == expected.size() );
+                if (n > 0) {
+                    REQUIRE( *(--(begin + n)) == expected.back() );
+                }
+
+                // lowered loops visit the same points with the same offsets
+                n = 0;
+                lattice::for_each(begin,false,
+                        [&](const int_d& index, const std::ptrdiff_t offset) {
+                    REQUIRE( index == expected[n] );
+                    REQUIRE( size_t(offset) == size_t(begin + n) );
+                    ++n;
+                });
+                REQUIRE( n == std::ptrdiff_t(expected.size()) );
+
+                // and a range that ends part way through the colour class
+                const std::ptrdiff_t half = expected.size()/2;
+                n = 0;
+                make_iterator_range(begin,begin + half).for_each(
+                        [&](const int_d& index) {
+                    REQUIRE( index == expected[n] );
+                    ++n;
+                });
+                REQUIRE( n == half );
+            }
+        }
+    }
+
+    SECTION( "parallel red-black" ) {
+        const int_d max = {{20,17,33}};
+        thread_pool pool(3);
+        const auto stride = lattice_iterator<D>(min,max).get_stride();
+        const std::ptrdiff_t origin = stride[0]*min[0] + stride[1]*min[1] + min[2];
+        std::vector<int> visits(21*14*35,0);
+        std::atomic<int> wrong_colour(0);
+        for (int colour = 0; colour < 2; ++colour) {
+            coloured_lattice_range<D> range(min,max,colour);
+            REQUIRE( range.size() == std::ptrdiff_t(make_iterator_range(
+                            iterator(min,max,colour),false).size()) );
+            parallel_for(range,[&](const int_d& index, const std::ptrdiff_t offset) {
+                const int sum = index[0] + index[1] + index[2];
+                if ((sum % 2 + 2) % 2 != colour) ++wrong_colour;
+                ++visits[offset - origin];
+            }, parallel_options<>(64,&pool));
+        }
+        REQUIRE( wrong_colour == 0 );
+        std::ptrdiff_t total = 0;
+        for (const int v: visits) {
+            REQUIRE( v <= 1 );
+            total += v;
+        }
+        REQUIRE( total == 21*14*35 );
+    }
+
+    SECTION( "reverse iteration from the end of a range" ) {
+        const int_d max = {{4,7,9}};
+        coloured_lattice_range<D> range(min,max,1,3);
+        const iterator begin(min,max,1,3);
+        const std::ptrdiff_t total = range.size();
+        REQUIRE( range.end() == false );
+        REQUIRE( range.end() - range.begin() == total );
+        REQUIRE( *std::prev(range.end()) == *(begin + (total-1)) );
+        std::ptrdiff_t n = total;
+        for (auto it = std::reverse_iterator<iterator>(range.end()); 
+             it != std::reverse_iterator<iterator>(range.begin()); ++it) {
+            --n;
+            REQUIRE( *it == *(begin + n) );
+        }
+        REQUIRE( n == 0 );
+        REQUIRE( coloured_lattice_range<D>(min,min,0).end() == iterator() );
+        REQUIRE( coloured_lattice_range<D>(min,min,0).size() == 0 );
+    }
+}
+
+template <typename Layout>
+void check_grid_layout() {
+    const unsigned int D = 3;
+    typedef std::array<int,D> int_d;
+    const int_d min = {{-1,3,2}};
+    const int_d max = {{6,8,11}};
+    grid<double,D,Layout> g(make_iterator_range(lattice_iterator<D>(min,max),
+                                                false));
+    REQUIRE( g.get_min() == min );
+    REQUIRE( g.get_max() == max );
+    REQUIRE( g.size() >= g.range().size() );
+
+    // storage order visits every point once, in increasing memory order
+    std::ptrdiff_t n = 0;
+    const double* last = nullptr;
+    g.for_each([&](const int_d& index, double& value) {
+        REQUIRE( &g[index] == &value );
+        REQUIRE( (last == nullptr || &value > last) );
+        last = &value;
+        value = 100*index[0] + 10*index[1] + index[2];
+        ++n;
+    });
+    REQUIRE( n == std::ptrdiff_t(g.range().size()) );
+    for (lattice_iterator<D> it(min,max); it != false; ++it) {
+        REQUIRE( g[it] == 100*(*it)[0] + 10*(*it)[1] + (*it)[2] );
+    }
+}
+
+TEST_CASE( "periodic iterator", "[iterator]" ) {
+    const unsigned int D = 2;
+    typedef std::array<int,D> int_d;
+    const int_d domain_min = {{0,-2}};
+    const int_d domain_max = {{9,6}};
+    const int_d min = {{-3,-4}};
+    const int_d max = {{8,7}};
+    const auto stride = lattice_iterator<D>(domain_min,domain_max).get_stride();
+    auto wrap = [&](int_d index) {
+        for (size_t i = 0; i < D; ++i) {
+            const int period = domain_max[i]-domain_min[i];
+            index[i] = domain_min[i] 
+                + ((index[i]-domain_min[i])%period + period)%period;
+        }
+        return index;
+    };
+    periodic_lattice_iterator<D> begin(domain_min,domain_max,min,max);
+
+    SECTION( "wrapped points" ) {
+        lattice_iterator<D> box(min,max);
+        periodic_lattice_iterator<D> it = begin;
+        for (int n = 0; box != false; ++box, ++it, ++n) {
+            REQUIRE( it != false );
+            REQUIRE( it.unwrapped() == *box );
+            const int_d wrapped = wrap(*box);
+            REQUIRE( *it == wrapped );
+            REQUIRE( size_t(it) == size_t(stride[0]*wrapped[0] + wrapped[1]) );
+            REQUIRE( *(begin + n) == *it );
+            REQUIRE( size_t(begin + n) == size_t(it) );
+            REQUIRE( it - begin == n );
+        }
+        REQUIRE( it == false );
+        REQUIRE( periodic_lattice_iterator<D>() - begin == 11*11 );
+        --it;
+        REQUIRE( it.unwrapped() == (int_d{{7,6}}) );
+        REQUIRE( *it == (int_d{{7,-2}}) );
+    }
+
+    SECTION( "neighbours" ) {
+        const std::vector<std::array<int,D>> displacements = {
+            {{0,0}}, {{-1,0}}, {{1,0}}, {{0,-1}}, {{0,1}}, {{2,-3}}};
+        periodic_neighbours<D> neighbours(domain_min,domain_max,displacements);
+        REQUIRE( neighbours.size() == 6 );
+        REQUIRE( neighbours.get_radius() == 3 );
+        std::vector<int> visits(9*8,0);
+        const int base = size_t(lattice_iterator<D>(domain_min,domain_max));
+        neighbours.for_each([&](const int_d& index, const std::ptrdiff_t offset,
+                                const std::ptrdiff_t* offsets) {
+            REQUIRE( offset == stride[0]*index[0] + index[1] );
+            ++visits[offset - base];
+            for (size_t n = 0; n < displacements.size(); ++n) {
+                int_d neighbour = index;
+                for (size_t i = 0; i < D; ++i) neighbour[i] += displacements[n][i];
+                neighbour = wrap(neighbour);
+                REQUIRE( offset + offsets[n] == stride[0]*neighbour[0] + neighbour[1] );
+            }
+        });
+        for (int v: visits) REQUIRE( v == 1 );
+    }
+}
+
+TEST_CASE( "ball iterator", "[iterator]" ) {
+    const unsigned int D = 3;
+    typedef std::array<int,D> int_d;
+    const int_d min = {{-2,0,1}};
+    const int_d max = {{6,7,9}};
+    const auto stride = lattice_iterator<D>(min,max).get_stride();
+    const std::array<int_d,3> centres = {{ {{2,3,5}}, {{-2,6,1}}, {{7,3,4}} }};
+    const std::array<double,5> radii = {{0.0,1.0,2.5,3.0,20.0}};
+    const std::array<ball_norm,3> norms = {{ball_norm::l1,ball_norm::l2,
+                                            ball_norm::linf}};
+    auto distance = [](const int_d& a, const int_d& b, const ball_norm norm) {
+        double ret = 0;
+        for (size_t i = 0; i < D; ++i) {
+            const double d = std::abs(a[i]-b[i]);
+            if (norm == ball_norm::l1) ret += d;
+            if (norm == ball_norm::l2) ret += d*d;
+            if (norm == ball_norm::linf) ret = std::max(ret,d);
+        }
+        return norm == ball_norm::l2 ? std::sqrt(ret) : ret;
+    };
+
+    for (const auto& centre: centres) {
+        for (const double radius: radii) {
+            for (const ball_norm norm: norms) {
+                std::vector<int_d> expected;
+                for (lattice_iterator<D> it(min,max); it != false; ++it) {
+                    if (distance(*it,centre,norm) <= radius) {
+                        expected.push_back(*it);
+                    }
+                }
+                lattice_ball_iterator<D> begin(min,max,centre,radius,norm);
+                lattice_ball_iterator<D> end;
+                REQUIRE( size_t(end - begin) == expected.size() );
+
+                lattice_ball_iterator<D> it = begin;
+                for (size_t n = 0; n < expected.size(); ++n, ++it) {
+                    REQUIRE( it != false );
+                    REQUIRE( *it == expected[n] );
+                    REQUIRE( size_t(it) == size_t(stride[0]*expected[n][0] 
+                                + stride[1]*expected[n][1] + expected[n][2]) );
+                    REQUIRE( *(begin + n) == expected[n] );
+                    REQUIRE( size_t(it - begin) == n );
+                }
+                REQUIRE( it == false );
+                for (size_t n = expected.size(); n > 0; --n) {
+                    --it;
+                    REQUIRE( *it == expected[n-1] );
+                }
+
+                size_t n = 0;
+                lattice::for_each(begin,false,
+                        [&](const int_d& index, const std::ptrdiff_t offset) {
+                    REQUIRE( index == expected[n] );
+                    REQUIRE( offset == std::ptrdiff_t(size_t(begin + n)) );
+                    ++n;
+                });
+                REQUIRE( n == expected.size() );
+                if (expected.size() > 2) {
+                    n = 2;
+                    lattice::for_each(begin + 2,false,[&](const int_d& index) {
+                        REQUIRE( index == expected[n++] );
+                    });
+                    REQUIRE( n == expected.size() );
+                }
+
+                // ranges that end part way through the ball (and its rows)
+                for (size_t last: {size_t(1),expected.size()/2,
+                                   expected.size() > 0 ? expected.size()-1 : 0}) {
+                    if (last > expected.size()) continue;
+                    n = 0;
+                    make_iterator_range(begin,begin + last).for_each(
+                            [&](const int_d& index) {
+                        REQUIRE( index == expected[n++] );
+                    });
+                    REQUIRE( n == last );
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE( "half shell", "[iterator]" ) {
+    const unsigned int D = 3;
+    typedef std::array<int,D> int_d;
+    const int_d min = {{-1,0,2}};
+    const int_d max = {{3,4,5}};
+    const auto stride = lattice_iterator<D>(min,max).get_stride();
+    REQUIRE( half_shell_size<1>() == 1 );
+    REQUIRE( half_shell_size<2>() == 4 );
+    REQUIRE( half_shell_size<3>() == 13 );
+
+    auto is_neighbour = [](const int_d& a, const int_d& b) {
+        bool same = true;
+        for (size_t i = 0; i < D; ++i) {
+            if (std::abs(a[i]-b[i]) > 1) return false;
+            if (a[i] != b[i]) same = false;
+        }
+        return !same;
+    };
+
+    SECTION( "each pair once" ) {
+        std::map<std::pair<int_d,int_d>,int> pairs;
+        for (lattice_iterator<D> cell(min,max); cell != false; ++cell) {
+            for (auto it = half_shell_begin(*cell,min,max); it != false; ++it) {
+                REQUIRE( is_neighbour(*cell,*it) );
+                REQUIRE( *cell < *it );
+                REQUIRE( size_t(it) == size_t(stride[0]*(*it)[0] 
+                                              + stride[1]*(*it)[1] + (*it)[2]) );
+                ++pairs[std::make_pair(*cell,*it)];
+            }
+        }
+        size_t expected = 0;
+        for (lattice_iterator<D> a(min,max); a != false; ++a) {
+            for (lattice_iterator<D> b(min,max); b != false; ++b) {
+                if (*a < *b && is_neighbour(*a,*b)) {
+                    ++expected;
+                    REQUIRE( pairs[std::make_pair(*a,*b)] == 1 );
+                }
+            }
+        }
+        REQUIRE( pairs.size() == expected );
+    }
+
+    SECTION( "periodic" ) {
+        std::map<std::pair<int_d,int_d>,int> pairs;
+        for (lattice_iterator<D> cell(min,max); cell != false; ++cell) {
+            auto it = periodic_half_shell_begin(*cell,min,max);
+            REQUIRE( size_t(periodic_lattice_iterator<D>() - it) 
+                        == half_shell_size<D>() );
+            for (; it != false; ++it) {
+                REQUIRE( size_t(it) == size_t(stride[0]*(*it)[0] 
+                                              + stride[1]*(*it)[1] + (*it)[2]) );
+                // each unordered pair of cells, with its displacement
+                int_d displacement;
+                for (size_t i = 0; i < D; ++i) {
+                    displacement[i] = it.unwrapped()[i] - (*cell)[i];
+                }
+                REQUIRE( is_neighbour(displacement,int_d{{0,0,0}}) );
+                ++pairs[std::minmax(*cell,*it)];
+            }
+        }
+        // every cell has 26 neighbours in a periodic box with at least 3 
+        // cells along each side, so there are 13 pairs per cell
+        const size_t cells = 4*4*3;
+        REQUIRE( pairs.size() == cells*half_shell_size<D>() );
+        for (const auto& pair: pairs) REQUIRE( pair.second == 1 );
+    }
+}
+
+TEST_CASE( "simplex iterator", "[iterator]" ) {
+    const unsigned int D = 3;
+    typedef std::array<int,D> int_d;
+    const int n = 9;
+    const auto stride = lattice_iterator<D>(int_d{{0,0,0}},int_d{{n,n,n}}).get_stride();
+    std::vector<int_d> expected;
+    for (lattice_iterator<D> it(int_d{{0,0,0}},int_d{{n,n,n}}); it != false; ++it) {
+        if ((*it)[0] < (*it)[1] && (*it)[1] < (*it)[2]) expected.push_back(*it);
+    }
+    simplex_iterator<D> begin(n);
+    simplex_iterator<D> end;
+    REQUIRE( begin.size() == 84 );
+    REQUIRE( expected.size() == 84 );
+
+    SECTION( "increment and random access" ) {
+        REQUIRE( size_t(end - begin) == expected.size() );
+        simplex_iterator<D> it = begin;
+        for (size_t i = 0; i < expected.size(); ++i, ++it) {
+            REQUIRE( it != false );
+            REQUIRE( *it == expected[i] );
+            REQUIRE( size_t(it) == size_t(stride[0]*expected[i][0] 
+                        + stride[1]*expected[i][1] + expected[i][2]) );
+            REQUIRE( *(begin + i) == expected[i] );
+            REQUIRE( size_t(begin + i) == size_t(it) );
+            REQUIRE( size_t(it - begin) == i );
+            REQUIRE( size_t(end - it) == expected.size() - i );
+        }
+        REQUIRE( it == false );
+        for (size_t i = expected.size(); i > 0; --i) {
+            --it;
+            REQUIRE( *it == expected[i-1] );
+        }
+    }
+
+    SECTION( "small and large n" ) {
+        REQUIRE( simplex_iterator<D>(2) == false );
+        REQUIRE( simplex_iterator<D>(3).size() == 1 );
+        REQUIRE( simplex_iterator<1>(5)[4][0] == 4 );
+        // 2^20 choose 3 tuples, more than 2^31
+        simplex_iterator<D> large(1<<20);
+        REQUIRE( large.size() == std::ptrdiff_t(192153034345676800) );
+        const auto last = large + (large.size()-1);
+        REQUIRE( *last == (int_d{{(1<<20)-3,(1<<20)-2,(1<<20)-1}}) );
+        REQUIRE( last - large == large.size()-1 );
+        const auto middle = large + large.size()/2;
+        REQUIRE( middle - large == large.size()/2 );
+        REQUIRE( *(middle + 1) == *std::next(middle) );
+        // n^D and the intermediate products overflow, but C(n,D) fits
+        simplex_iterator<D> huge(3000000);
+        REQUIRE( huge.size() == std::ptrdiff_t(4499995500001000000) );
+        REQUIRE( *(huge + (huge.size()-1)) 
+                    == (int_d{{3000000-3,3000000-2,3000000-1}}) );
+        simplex_iterator<4> quads(100000);
+        REQUIRE( quads.size() == std::ptrdiff_t(4166416671249975000) );
+        REQUIRE( (quads + (quads.size()-1)) - quads == quads.size()-1 );
+    }
+
+    SECTION( "split and parallel for" ) {
+        simplex_range<D> range(n,10);
+        REQUIRE( range.size() == 84 );
+        simplex_range<D> upper(range,split());
+        REQUIRE( range.size() == 42 );
+        REQUIRE( upper.size() == 42 );
+        REQUIRE( *upper.begin() == expected[42] );
+        REQUIRE( range.end() == upper.begin() );
+        size_t i = 42;
+        upper.for_each([&](const int_d& index) { REQUIRE( index == expected[i++] ); });
+        REQUIRE( i == expected.size() );
+
+        thread_pool pool(4);
+        std::vector<std::atomic<int>> visits(n*n*n);
+        for (auto& v: visits) v = 0;
+        parallel_for(simplex_range<D>(n),
+                     [&](const int_d&, const std::ptrdiff_t offset) {
+            ++visits[offset];
+        }, parallel_options<>(5,&pool));
+        for (const int_d& index: expected) {
+            REQUIRE( visits[stride[0]*index[0] + stride[1]*index[1] + index[2]] == 1 );
+        }
+        int total = 0;
+        for (auto& v: visits) total += v;
+        REQUIRE( total == 84 );
+    }
+}
+
+TEST_CASE( "masked range", "[range]" ) {
+    const unsigned int D = 3;
+    typedef std::array<int,D> int_d;
+    const int_d min = {{-3,1,0}};
+    const int_d max = {{9,14,150}};
+    const auto stride = lattice_iterator<D>(min,max).get_stride();
+    // an irregular domain with long runs, some rows full, some empty and 
+    // some isolated points
+    auto active = [](const int_d& i) {
+        return (i[0]*i[0] + (i[1]-7)*(i[1]-7) < 30 && i[2] > 3*i[1])
+               || i[1] == 5 || (i[0]*31 + i[1]*17 + i[2]*7) % 23 == 0;
+    };
+    std::vector<int_d> expected;
+    for (lattice_iterator<D> it(min,max); it != false; ++it) {
+        if (active(*it)) expected.push_back(*it);
+    }
+    masked_lattice_range<D> range(min,max,make_lattice_mask(min,max,active));
+    REQUIRE( size_t(range.size()) == expected.size() );
+
+    SECTION( "iteration and random access" ) {
+        auto it = range.begin();
+        for (size_t i = 0; i < expected.size(); ++i, ++it) {
+            REQUIRE( it != false );
+            REQUIRE( *it == expected[i] );
+            REQUIRE( size_t(it) == size_t(stride[0]*expected[i][0] 
+                        + stride[1]*expected[i][1] + expected[i][2]) );
+            REQUIRE( *(range.begin() + i) == expected[i] );
+            REQUIRE( size_t(it - range.begin()) == i );
+        }
+        REQUIRE( it == false );
+        REQUIRE( it == range.end() );
+        for (size_t i = expected.size(); i > 0; --i) {
+            --it;
+            REQUIRE( *it == expected[i-1] );
+        }
+        size_t i = 0;
+        range.for_each([&](const int_d& index, const std::ptrdiff_t offset) {
+            REQUIRE( index == expected[i] );
+            REQUIRE( offset == std::ptrdiff_t(size_t(range.begin() + i)) );
+            ++i;
+        });
+        REQUIRE( i == expected.size() );
+    }
+
+    SECTION( "spans" ) {
+        for (const auto& span: range.get_spans()) {
+            REQUIRE( span.first[2] < span.end );
+            REQUIRE( span.end <= max[2] );
+            int_d before = span.first;
+            --before[2];
+            int_d after = span.first;
+            after[2] = span.end;
+            REQUIRE( (before[2] < min[2] || !active(before)) );
+            REQUIRE( (after[2] == max[2] || !active(after)) );
+        }
+    }
+
+    SECTION( "split and parallel for" ) {
+        masked_lattice_range<D> lower(min,max,make_lattice_mask(min,max,active),10);
+        masked_lattice_range<D> upper(lower,split());
+        REQUIRE( lower.size() + upper.size() == range.size() );
+        REQUIRE( lower.end() == upper.begin() );
+        REQUIRE( *upper.begin() == expected[lower.size()] );
+        REQUIRE( std::abs(double(lower.size()) - upper.size()) < 0.1*range.size() );
+
+        thread_pool pool(4);
+        std::vector<std::atomic<int>> visits(12*13*150);
+        for (auto& v: visits) v = 0;
+        const std::ptrdiff_t origin = size_t(lattice_iterator<D>(min,max));
+        parallel_for(range,[&](const int_d&, const std::ptrdiff_t offset) {
+            ++visits[offset - origin];
+        }, parallel_options<>(100,&pool));
+        size_t total = 0;
+        for (lattice_iterator<D> it(min,max); it != false; ++it) {
+            const int v = visits[size_t(it) - origin];
+            REQUIRE( v == (active(*it) ? 1 : 0) );
+            total += v;
+        }
+        REQUIRE( total == expected.size() );
+    }
+
+    SECTION( "empty and full masks" ) {
+        auto none = [](const int_d&) { return false; };
+        auto all = [](const int_d&) { return true; };
+        masked_lattice_range<D> empty(min,max,make_lattice_mask(min,max,none));
+        REQUIRE( empty.size() == 0 );
+        REQUIRE( empty.begin() == false );
+        masked_lattice_range<D> full(min,max,make_lattice_mask(min,max,all));
+        REQUIRE( full.size() == 12*13*150 );
+        REQUIRE( full.get_spans().size() == 12*13 );
+    }
+}
+
+TEST_CASE( "grid", "[grid]" ) {
+    const std::array<int,2> p12 = {{1,2}};
+    const std::array<int,2> p20 = {{2,0}};
+    SECTION( "row major" ) {
+        check_grid_layout<row_major>();
+        grid<double,2> g(std::array<int,2>{{0,0}},std::array<int,2>{{3,4}},1.0);
+        REQUIRE( g.size() == 12 );
+        REQUIRE( &g[p12] == g.data() + 6 );
+    }
+    SECTION( "padded row major" ) {
+        check_grid_layout<padded_row_major<4>>();
+        const std::array<int,3> min = {{0,0,-2}};
+        const std::array<int,3> max = {{3,4,14}};
+        grid<double,3,padded_row_major<8>> g(min,max);
+        // 16 is an even number of 8s, so the pitch is 24
+        REQUIRE( g.get_stride()[2] == 1 );
+        REQUIRE( g.get_stride()[1] == 24 );
+        REQUIRE( g.get_stride()[0] == 4*24 );
+        REQUIRE( g.size() == 3*4*24 );
+        REQUIRE( reinterpret_cast<std::uintptr_t>(g.data()) % 64 == 0 );
+        for (lattice_iterator<3> it(min,max,g.get_stride()); it != false; ++it) {
+            REQUIRE( &g[it] == g.data() + size_t(it) - g.get_mapping().get_origin() );
+            if ((*it)[2] == min[2]) {
+                REQUIRE( reinterpret_cast<std::uintptr_t>(&g[it]) % 64 == 0 );
+            }
+        }
+        // iterators with other strides are indexed by their coordinates
+        const lattice_iterator<3> dense(min,max);
+        REQUIRE( &g[dense + 17] == &g[*(dense + 17)] );
+    }
+    SECTION( "column major" ) {
+        check_grid_layout<column_major>();
+        grid<double,2,column_major> g(std::array<int,2>{{0,0}},
+                                      std::array<int,2>{{3,4}});
+        REQUIRE( &g[p12] == g.data() + 7 );
+    }
+    SECTION( "tiled" ) {
+        check_grid_layout<tiled<2,4,4>>();
+        grid<double,2,tiled<2,2>> g(std::array<int,2>{{0,0}},
+                                    std::array<int,2>{{3,4}});
+        // padded to 2x2 tiles of 4
+        REQUIRE( g.size() == 16 );
+        REQUIRE( &g[p12] == g.data() + 6 );
+        REQUIRE( &g[p20] == g.data() + 8 );
+    }
+    SECTION( "morton" ) {
+        check_grid_layout<morton>();
+        grid<double,2,morton> g(std::array<int,2>{{0,0}},
+                                std::array<int,2>{{4,4}});
+        REQUIRE( g.size() == 16 );
+        REQUIRE( &g[p12] == g.data() + 6 );
+    }
+}
+
+template <typename Layout>
+void check_halo_grid() {
+    const unsigned int D = 3;
+    typedef std::array<int,D> int_d;
+    const int_d min = {{0,-2,1}};
+    const int_d max = {{4,3,7}};
+    const int_d width = {{1,2,3}};
+    halo_grid<int,D,Layout> g(min,max,width,0);
+    REQUIRE( g.get_min() == (int_d{{-1,-4,-2}}) );
+    REQUIRE( g.get_max() == (int_d{{5,5,10}}) );
+    REQUIRE( g.interior().size() == 4*5*6 );
+
+    // the interior and the halo regions cover the grid exactly once
+    const auto halo = g.halo();
+    REQUIRE( halo.size() == 26 );
+    REQUIRE( g.face(0,-1).begin().get_max() == (int_d{{0,3,7}}) );
+    REQUIRE( halo[0].begin() == g.face(0,-1).begin() );
+    std::array<int,D> corner = {{1,1,1}};
+    REQUIRE( halo.back().begin() == g.region(corner).begin() );
+    for (auto it = g.interior().begin(); it != false; ++it) {
+        ++g[it];
+    }
+    size_t halo_size = 0;
+    for (const auto& region: halo) {
+        halo_size += region.size();
+        region.for_each([&](const int_d& index) { ++g[index]; });
+    }
+    REQUIRE( halo_size + g.interior().size() == g.all().size() );
+    g.for_each([](const int_d&, const int value) { 
+        REQUIRE( value == 1 ); 
+    });
+}
+
+TEST_CASE( "halo grid", "[grid]" ) {
+    SECTION( "row major" ) {
+        check_halo_grid<row_major>();
+        // the ranges use the storage strides
+        halo_grid<double,2> g(std::array<int,2>{{0,0}},std::array<int,2>{{3,4}},1);
+        for (auto it = g.interior().begin(); it != false; ++it) {
+            REQUIRE( &g[it] == g.data() + size_t(it) - g.get_mapping().get_origin() );
+        }
+    }
+    SECTION( "padded" ) {
+        check_halo_grid<padded_row_major<>>();
+    }
+    SECTION( "zero width" ) {
+        typedef std::array<int,2> int2;
+        halo_grid<double,2> g(int2{{0,0}},int2{{3,4}},int2{{1,0}});
+        size_t halo_size = 0;
+        size_t visited = 0;
+        for (const auto& region: g.halo()) {
+            halo_size += region.size();
+            for (auto it = region.begin(); it != false; ++it) ++visited;
+        }
+        REQUIRE( halo_size == 8 );
+        REQUIRE( visited == 8 );
+        REQUIRE( g.face(1,-1).size() == 0 );
+        REQUIRE( g.face(1,-1).begin() == false );
+    }
+    SECTION( "tiled" ) {
+        check_halo_grid<tiled<2,2,2>>();
+    }
+}
+
 template <int O>
 double stencil(const int i) {
     const std::array<double,O+1> coeff = {{1.0,-2.0,1.0}};
@@ -116,6 +1569,122 @@ double stencil<6>(const int i) {
 }
 
 
+TEST_CASE( "static stencil", "[stencil]" ) {
+    SECTION( "taps" ) {
+        typedef laplacian_stencil<3,4>::type laplacian;
+        REQUIRE( laplacian::size() == 13 );
+        const std::array<std::ptrdiff_t,3> stride = {{100,10,1}};
+        const auto offsets = laplacian::linear_offsets(stride);
+        REQUIRE( offsets[0] == 0 );
+        REQUIRE( offsets[1] == -100 );
+        REQUIRE( offsets[2] == 100 );
+        REQUIRE( offsets[3] == -200 );
+        REQUIRE( offsets[12] == 2 );
+        // the Laplacian of a constant is zero, and of x^2+y^2+z^2 is 6
+        std::vector<double> u(1000,1.0);
+        REQUIRE( laplacian::apply(u.data()+555,offsets) == Approx(0.0) );
+        for (lattice_iterator<3> it({{0,0,0}},{{10,10,10}}); it != false; ++it) {
+            u[size_t(it)] = (*it)[0]*(*it)[0] + (*it)[1]*(*it)[1] 
+                            + (*it)[2]*(*it)[2];
+        }
+        REQUIRE( laplacian::apply(u.data()+555,offsets) == Approx(6.0) );
+    }
+
+    SECTION( "apply" ) {
+        const unsigned int D = 2;
+        typedef std::array<int,D> int_d;
+        const int order = 4;
+        const double r = 0.1;
+        const int_d min = {{0,0}};
+        const int_d max = {{13,9}};
+        halo_grid<double,D,padded_row_major<>> u0(min,max,order/2), u1(min,max,order/2);
+        u0.all().for_each([&](const int_d& i) { u0[i] = std::sin(i[0]+2*i[1]); });
+        apply_stencil<laplacian_stencil<D,order>::type>(u0,u1,u0.interior(),r,1.0);
+        u0.interior().for_each([&](const int_d& i) {
+            double expected = u0[i];
+            for (unsigned int d = 0; d < D; ++d) {
+                for (int j = -order/2; j <= order/2; ++j) {
+                    int_d neighbour = i;
+                    neighbour[d] += j;
+                    expected += r*stencil<order>(j)*u0[neighbour];
+                }
+            }
+            REQUIRE( u1[i] == Approx(expected) );
+        });
+        // the halo is not written
+        u1.face(0,1).for_each([&](const int_d& i) { REQUIRE( u1[i] == 0.0 ); });
+
+        // only ranges over a whole box can be passed to apply_stencil
+        lattice_range<D> whole(min,max);
+        lattice_range<D> upper(whole,split());
+        REQUIRE( detail::covers_box(u0.interior()) );
+        REQUIRE( detail::covers_box(whole) );
+        REQUIRE( detail::covers_box(upper) );
+        const lattice_iterator<D> begin(min,max);
+        REQUIRE_FALSE( detail::covers_box(make_iterator_range(begin+1,false)) );
+        REQUIRE_FALSE( detail::covers_box(make_iterator_range(begin,begin+5)) );
+    }
+
+    SECTION( "periodic" ) {
+        const unsigned int D = 2;
+        typedef std::array<int,D> int_d;
+        const int order = 4;
+        const double r = 0.1;
+        const int_d min = {{-2,1}};
+        // including boxes no wider than the stencil radius
+        for (const int_d max: {int_d{{11,4}},int_d{{-1,7}},int_d{{9,3}},
+                               int_d{{-1,2}}}) {
+            grid<double,D> u0(min,max), u1(min,max);
+            u0.for_each([&](const int_d& i, double& value) { 
+                value = std::sin(i[0]+2*i[1]); 
+            });
+            apply_stencil_periodic<laplacian_stencil<D,order>::type>(
+                    u0,u1,u0.range(),r,1.0);
+            u0.for_each([&](const int_d& i, const double value) {
+                double expected = value;
+                for (unsigned int d = 0; d < D; ++d) {
+                    for (int j = -order/2; j <= order/2; ++j) {
+                        int_d neighbour = i;
+                        neighbour[d] += j;
+                        const int period = max[d]-min[d];
+                        neighbour[d] = min[d] 
+                            + ((neighbour[d]-min[d])%period + period)%period;
+                        expected += r*stencil<order>(j)*u0[neighbour];
+                    }
+                }
+                REQUIRE( u1[i] == Approx(expected) );
+            });
+        }
+    }
+}
+
+TEST_CASE( "temporal blocking", "[stencil]" ) {
+    const unsigned int D = 3;
+    typedef std::array<int,D> int_d;
+    typedef laplacian_stencil<D,4>::type laplacian;
+    const int_d min = {{0,0,0}};
+    const int_d max = {{23,7,9}};
+    const double r = 0.05;
+    for (const int steps: {1,2,5}) {
+        for (const int block_width: {1,4,32}) {
+            halo_grid<double,D> u0(min,max,2), u1(min,max,2);
+            u0.all().for_each([&](const int_d& i) { 
+                u0[i] = u1[i] = std::sin(i[0]+2*i[1]+3*i[2]); 
+            });
+            halo_grid<double,D> v0 = u0, v1 = u1;
+            for (int step = 0; step < steps; ++step) {
+                apply_stencil<laplacian>(v0,v1,v0.interior(),r,1.0);
+                std::swap(v0,v1);
+            }
+            advance_stencil<laplacian>(u0,u1,u0.interior(),steps,r,1.0,
+                                       block_width);
+            u0.for_each([&](const int_d& i, const double value) {
+                REQUIRE( value == v0[i] );
+            });
+        }
+    }
+}
+
 TEST_CASE( "finite difference") {
     const unsigned int D = 2;
     typedef std::array<int,D> int_d;
@@ -136,31 +1705,33 @@ TEST_CASE( "finite difference") {
     const int_d max_left = {{order/2,m+order}};
     const int_d min_right = {{n+order/2,0}};
 
+    const auto stride = lattice_iterator<D>(min,max).get_stride();
+
 #if __cplusplus > 201402L
     auto all = make_iterator_range(
                         lattice_iterator<D>(min,max),
                         false);
     auto domain = make_iterator_range(
-                        lattice_iterator<D>(min_domain,max_domain),
+                        lattice_iterator<D>(min_domain,max_domain,stride),
                         false);
     auto left_boundary = make_iterator_range(
-                        lattice_iterator<D>(min,max_left),
+                        lattice_iterator<D>(min,max_left,stride),
                         false);
     auto right_boundary = make_iterator_range(
-                        lattice_iterator<D>(min_right,max),
+                        lattice_iterator<D>(min_right,max,stride),
                         false);
 #else
     auto all = make_iterator_range(
                         lattice_iterator<D>(min,max),
                         lattice_iterator<D>());
     auto domain = make_iterator_range(
-                        lattice_iterator<D>(min_domain,max_domain),
+                        lattice_iterator<D>(min_domain,max_domain,stride),
                         lattice_iterator<D>());
     auto left_boundary = make_iterator_range(
-                        lattice_iterator<D>(min,max_left),
+                        lattice_iterator<D>(min,max_left,stride),
                         lattice_iterator<D>());
     auto right_boundary = make_iterator_range(
-                        lattice_iterator<D>(min_right,max),
+                        lattice_iterator<D>(min_right,max,stride),
                         lattice_iterator<D>());
 #endif
 
@@ -168,38 +1739,23 @@ TEST_CASE( "finite difference") {
     std::vector<double> values0(all.size(),0.0);
     std::vector<double> values1(all.size(),0.0);
 
-    auto calculate = [&](const int_d& index) {
-        int ret = 0;
-        unsigned int multiplier = 1.0;
-        for (size_t i = 0; i<D; ++i) {
-            if (i > 0) {
-                multiplier *= max[i-1];
-            }
-            ret += multiplier*index[i];
-        }
-        return ret;
-    };
-
-
-    for(const auto& index: left_boundary) {
-        values0[calculate(index)] = 1.0;
-        values1[calculate(index)] = 1.0;
+    for (auto it = left_boundary.begin(); it != false; ++it) {
+        values0[size_t(it)] = 1.0;
+        values1[size_t(it)] = 1.0;
     }
-    for(const auto& index: right_boundary) {
-        values0[calculate(index)] = 1.0;
-        values1[calculate(index)] = 1.0;
+    for (auto it = right_boundary.begin(); it != false; ++it) {
+        values0[size_t(it)] = 1.0;
+        values1[size_t(it)] = 1.0;
     }
 
     for (int i = 0; i < timesteps; ++i) {
-        for(const auto& index: domain) {
-            const size_t base_index = calculate(index);
+        for (auto it = domain.begin(); it != false; ++it) {
+            const size_t base_index = size_t(it);
             values1[base_index] = values0[base_index];
             for (unsigned int d = 0; d < D; d++) {
-                int_d stencil_index = index;
                 for (int j = -order/2; j <= order/2; j++) {
-                    stencil_index[d] = j+index[d];
                     const double coeff = stencil<order>(j);
-                    values1[base_index] += r*coeff*values0[calculate(stencil_index)];
+                    values1[base_index] += r*coeff*values0[base_index + j*stride[d]];
                 } 
             }
         }